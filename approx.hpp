@@ -1,13 +1,24 @@
 // Matrix approximation using a fixed set of basic matrices
 //
+#ifndef approx_h__
+#define approx_h__
 
 #include <armadillo>
 #include <stdexcept>
 #include "simplify.hpp"
 #include <ctime>
+#include <functional>
 #include "config.hpp"
 
 typedef std::map<std::string, tOper> tIsetDict;
+typedef std::pair<double, tOper> tApproxHit;  // (distance to target, basic approximation)
+
+// Anything able to return the basic approximation closest to a target
+// (sharded table, ...)
+class ApproxLookup {
+public:
+	virtual tApproxHit lookup(cx_mat target) = 0;
+};
 
 class BasicApproxSettings {
 public:
@@ -16,8 +27,11 @@ public:
 	tArrayOp iset;
 	ruleSet rSet;
 	SimplifyEngine sse;
+	tArrayOp approxes;
+	std::function<void(tOper &)> observer;   // sees every sequence kept by generation, if set
+	std::function<bool(tOper &)> filter;     // if set, generation keeps only the sequences it accepts
 
-	BasicApproxSettings::BasicApproxSettings() {
+	BasicApproxSettings() {
 		cx_mat matrix;
 		matrix = zeros<cx_mat>(0, 0);
 		Oper identity ("N",matrix);
@@ -56,58 +70,114 @@ public:
 		};
 	};
 
-	SimplifyEngine init_simplify_engine(ruleSet rSet) {
-		SimplifyEngine sse(rSet);
+	SimplifyEngine init_simplify_engine(ruleSet rs) {
+		rSet = rs;
+		sse = SimplifyEngine(rSet);
 		return(sse);
 	}
 
-	tSimplified BasicApproxSettings::simplify(tArrayOp seq) { 
+	tSimplified simplify(tArrayOp seq) { 
 		return(sse.simplify(seq));
 	};
 
-	bool simplify_new(BasicApproxSettings &ss1, tOper &new_op) {
-		// Have to convert a string of ancestors in array of ancestors operators
-		std::string ancs = new_op.ancestors;
-		tOper new_ancestor;
+	// Converts a string of ancestors in an array of instructions.
+	// Names can be longer than one char ("Td"), so the longest match wins.
+	tArrayOp ancestors_to_array(std::string ancs) {
 		tArrayOp arrayAncestors;
-		std::string simplified_ancestors = "";
+		size_t pos = 0;
 
-		// Array creation from ancestors label
-		size_t l_ancs = ancs.length();
-		for (int i = 0; i < l_ancs; i++) {
-			for (auto j : baseOpSet) {
-				if (ancs[i] == j.name) arrayAncestors.push_back(j) ;
+		while (pos < ancs.length()) {
+			tIsetDict::iterator best = iset_dict.end();
+			for (tIsetDict::iterator j = iset_dict.begin(); j != iset_dict.end(); ++j) {
+				if (ancs.compare(pos, j->first.length(), j->first) != 0) continue;
+				if ((best == iset_dict.end()) || (j->first.length() > best->first.length())) best = j;
 			};
+			if (best == iset_dict.end()) throw domain_error("Unknown instruction in ancestors " + ancs);
+			arrayAncestors.push_back(best->second);
+			pos += best->first.length();
 		};
+		return(arrayAncestors);
+	};
 
-		// calling simplify method
-		tSimplified ancsimp = ss1.simplify(arrayAncestors);
-		
+	// Name of the adjoint of an instruction: Q -> Qd, Qd -> Q, or Q
+	// itself when it is self-adjoint (H)
+	std::string dagger_name(std::string name) {
+		std::string dn = utils::dagger_and_simplify(name);
+		if (iset_dict.count(dn) > 0) return(dn);
+		tOper op = iset_dict[name];
+		if (utils::fowler_distance(op.matrix, op.matrix.t()) < 1e-6) return(name);
+		throw domain_error("No adjoint of " + name + " in the instruction set");
 	};
 
-	void gen_basic_approx_generation(BasicApproxSettings &ss1, tArrayOp &s1) {
-		//reset_global_sequences();
-		//reset_generation_stats();
-		extern bool simplify_new;
+	// Ancestors of the adjoint of a sequence
+	std::string dagger_sequence(std::string ancs) {
+		tArrayOp seq = ancestors_to_array(ancs);
+		std::string out;
 
-		tArrayOp simplified_ancestors = {};
-		for (auto i : s1) {
-			for (auto insn : iset) {
-				tOper new_op = i.add_ancestor(insn,"");
-				bool already_done = simplify_new(ss1, new_op);
-			};
+		for (tArrayOp::reverse_iterator it = seq.rbegin(); it != seq.rend(); ++it) out += dagger_name(it->name);
+		return(out);
+	};
+
+	// Cancels adjacent Q Q^dagger pairs, e.g. at the seams of
+	// concatenated sequences
+	tArrayOp reduce_adjacent(tArrayOp seq) {
+		tArrayOp out;
+
+		for (auto op : seq) {
+			if (!out.empty() && (dagger_name(out.back().name) == op.name)) out.pop_back();
+			else out.push_back(op);
+		};
+		return(out);
+	};
+
+	// True if the simplification engine changes the sequence at all
+	bool rewrites(tArrayOp seq) {
+		tSimplified simp = simplify(seq);
+
+		if (simp.second.size() != seq.size()) return(true);
+		for (size_t i = 0; i < seq.size(); i++) if (simp.second[i].name != seq[i].name) return(true);
+		return(false);
+	};
+
+	// True if the simplification engine rewrites the sequence, i.e. an
+	// equivalent sequence, shorter or first in shortlex order (mined rules of
+	// equal length), was already produced
+	bool simplify_new(BasicApproxSettings &ss1, tOper &new_op) {
+		return(ss1.rewrites(ancestors_to_array(new_op.ancestors)));
+	};
+
+	// Extends a prefix with every instruction, appending the sequences
+	// that survive simplification to s2
+	void gen_basic_approx_children(BasicApproxSettings &ss1, tOper &prefix, tArrayOp &s2) {
+		for (auto insn : iset) {
+			tOper new_op = prefix.multiply(insn, "");
+			if (simplify_new(ss1, new_op)) continue;
+			new_op.name = new_op.ancestors;
+			if (ss1.filter && !ss1.filter(new_op)) continue;
+			if (ss1.observer) ss1.observer(new_op);
+			s2.push_back(new_op);
 		};
 	};
 
+	tArrayOp gen_basic_approx_generation(BasicApproxSettings &ss1, tArrayOp &s1) {
+		tArrayOp s2 = {};
+		SKT_PERF_REGION("generation");
+
+		for (auto i : s1) gen_basic_approx_children(ss1, i, s2);
+		return(s2);
+	};
+
 	// Generate table of basic approximations as preprocessing
 	// ll_0 - fixed length of sequences to generate for preprocessing table
 	void basic_approxes(int &ll0, BasicApproxSettings &sett) {
-		BasicApproxSettings settings = sett;
+		tArrayOp generation = sett.iset;
 
-		//reset_global_stats();
-		//set_filename_suffix("g1");
-		gen_basic_approx_generation(sett, { settings.identity });
-		//print_generation_stats(1);
+		sett.approxes = generation;
+		for (int l = 2; l <= ll0; l++) {
+			generation = gen_basic_approx_generation(sett, generation);
+			sett.approxes.insert(sett.approxes.end(), generation.begin(), generation.end());
+			cout << "Generation " + to_string(l) + ": " + to_string(generation.size()) + " sequences" << endl;
+		};
 	};
 
 	void generate_approxes(int l0, BasicApproxSettings setts) {
@@ -127,3 +197,4 @@ public:
 	};
 };
 
+#endif // approx_h__
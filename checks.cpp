@@ -0,0 +1,273 @@
+// Regression checks of the table variants and compilers
+//
+// usage: sktcheck
+// Prints one line per check and exits with the number of failed checks.
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <armadillo>
+#include "config.hpp"
+
+int n_failed = 0;
+
+std::string sci(double x) {
+	std::ostringstream out;
+	out << std::scientific << std::setprecision(1) << x;
+	return(out.str());
+};
+
+void check(std::string name, bool ok, std::string detail) {
+	cout << (ok ? "PASS " : "FAIL ") + name + ": " + detail << endl;
+	if (!ok) n_failed++;
+};
+
+// The adjoint of every sequence is the product of its daggered gates
+void check_fixed_dagger(BasicApproxSettings &settings) {
+	double worst = 0;
+
+	for (auto &op : settings.approxes) {
+		FixedOper<2> d = FixedOper<2>(op).dagger(settings);
+		worst = std::max(worst, fixed_fowler_distance(d.matrix, fixed_sequence_matrix<2>(settings, d.ancestors)));
+	};
+	check("FixedOper::dagger", worst < 1e-6, "worst distance " + sci(worst) + " over " + to_string(settings.approxes.size()) + " sequences");
+};
+
+// Unit quaternions from a fixed seed
+std::vector<tQuat> random_targets(int n, unsigned seed) {
+	std::mt19937 gen(seed);
+	std::normal_distribution<double> normal(0, 1);
+	std::vector<tQuat> out;
+
+	for (int i = 0; i < n; i++) {
+		tQuat q;
+		double norm = 0;
+		for (auto &x : q) {
+			x = normal(gen);
+			norm += x * x;
+		};
+		for (auto &x : q) x /= sqrt(norm);
+		out.push_back(q);
+	};
+	return(out);
+};
+
+// The canonical lookup against a scan of all 48 transforms of every sequence,
+// and its answer against the distance it reports
+void check_clifford_lookup(BasicApproxSettings &settings) {
+	CliffordTable ct(settings);
+	std::vector<cx_mat> cliffords;
+	double worst = 0;
+
+	for (auto &op : settings.approxes) ct.add(op);
+	for (auto &c : ct.cliffords) {
+		tArrayOp word = settings.ancestors_to_array(c.word);
+		cliffords.push_back(ct.sequence_matrix(word));
+	};
+	for (auto &q : random_targets(20, 28)) {
+		cx_mat target = utils::quaternion_matrix(q);
+		double brute = HUGE_VAL;
+		for (auto &op : settings.approxes) {
+			for (auto &C : cliffords) {
+				brute = std::min(brute, utils::fowler_distance(C * op.matrix * C.t(), target));
+				brute = std::min(brute, utils::fowler_distance(C * op.matrix.t() * C.t(), target));
+			};
+		};
+		tApproxHit hit = ct.lookup(target);
+		tArrayOp seq = settings.ancestors_to_array(hit.second.ancestors);
+		worst = std::max(worst, fabs(hit.first - brute));
+		worst = std::max(worst, fabs(utils::fowler_distance(ct.sequence_matrix(seq), target) - hit.first));
+	};
+	check("CliffordTable::lookup", worst < 1e-6, "worst difference to brute force " + sci(worst) + " over 20 targets");
+};
+
+// KAK round trip: the exact circuit of U (4 local layers, 3 CNOTs) is U up to
+// phase, with every local factor in SU(2). Random U plus local, CNOT and identity.
+void check_kak_round_trip() {
+	std::mt19937 gen(41);
+	std::normal_distribution<double> normal(0, 1);
+	double worst = 0, worst_det = 0;
+	int n = 0;
+
+	for (int k = 0; k < 50; k++) {
+		cx_mat A(4, 4), U;
+		for (int i = 0; i < 4; i++) {
+			for (int j = i; j < 4; j++) {
+				complex<double> z(normal(gen), (i == j) ? 0 : normal(gen));
+				A(i, j) = z;
+				A(j, i) = conj(z);
+			};
+		};
+		U = expmat(complex<double>(0, 1) * A) * complex<double>(cos(k), sin(k));
+		if (k == 0) U = kron(H.matrix, T.matrix);
+		if (k == 1) U = cnot_matrix(0);
+		if (k == 2) U = eye<cx_mat>(4, 4);
+
+		tTwoQubitCircuit c = two_qubit_circuit(U);
+		worst = std::max(worst, utils::fowler_distance(circuit_matrix(c.local, c.control), U));
+		for (int layer = 0; layer < 4; layer++)
+			for (int q = 0; q < 2; q++) worst_det = std::max(worst_det, abs(det(c.local[layer][q]) - 1.0));
+		n++;
+	};
+	check("two_qubit_circuit", (worst < 1e-6) && (worst_det < 1e-9), "worst distance " + sci(worst)
+		+ ", worst |det - 1| " + sci(worst_det) + " over " + to_string(n) + " unitaries");
+};
+
+// Passes every SK base case to a session and to the table itself
+class CompareLookup: public ApproxLookup {
+public:
+	LookupSession *session;
+	CurveTable *cold;
+	double worst;
+	size_t n;
+
+	CompareLookup(LookupSession &s, CurveTable &c) {
+		session = &s;
+		cold = &c;
+		worst = 0;
+		n = 0;
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		tApproxHit warm = session->lookup(target);
+		tApproxHit hit = cold->lookup(target);
+
+		worst = std::max(worst, fabs(warm.first - hit.first));
+		n++;
+		return(warm);
+	};
+};
+
+// A session answers the SK base cases at the distance of a cold lookup
+void check_session(BasicApproxSettings &settings) {
+	PrefixTable pt(settings);
+	CurveTable ct(CURVE_HILBERT, 256);
+
+	pt.generate(12);
+	tArrayOp table = pt.to_array();
+	ct.build(table);
+	LookupSession ls(ct);
+	CompareLookup cmp(ls, ct);
+	SKApprox sk(cmp, settings);
+	for (auto &q : random_targets(10, 43)) sk.solovay_kitaev(utils::quaternion_matrix(q), 3);
+	check("LookupSession::lookup", cmp.worst < 1e-12, "worst difference to the cold lookup " + sci(cmp.worst) + " over "
+		+ to_string(cmp.n) + " SK lookups, " + to_string(ls.n_warm) + " warm");
+};
+
+// Table size extrapolated by the planner from l0 <= 6 against the l0 = 8 table
+void check_planner(BasicApproxSettings &settings) {
+	ApproxPlanner planner(settings, 6, 50);
+
+	planner.measure();
+	double predicted = planner.table_stats("linear", 8).entries;
+	double actual = (double)settings.approxes.size();
+	check("ApproxPlanner::table_stats", fabs(predicted - actual) < 0.25 * actual, "predicted " + to_string((long)predicted)
+		+ " sequences at l0 = 8, generated " + to_string((long)actual));
+};
+
+// The daemon's SIMPLIFY answer: the whole sequence, not only its tail
+void check_simplify_request(BasicApproxSettings &settings) {
+	tArrayOp seq = settings.ancestors_to_array("HTTdH");
+	std::string out = utils::list_as_string(simplify_sequence(settings.sse, seq));
+
+	check("simplify_sequence", out.empty(), "HTTdH -> \"" + out + "\"");
+};
+
+// Random sequences pushed in chunks of 1..7 gates. With a window holding
+// the whole stream the result is the fixed point of simplify_sequence;
+// with the default window gates leave before a deeper cancellation can
+// reach them, so the result only keeps the unitary.
+void check_stream_simplifier(BasicApproxSettings &settings) {
+	std::mt19937 gen(36);
+	size_t n_exact = 0, n_differ = 0, n_seqs = 200;
+	double worst = 0;
+
+	for (size_t t = 0; t < n_seqs; t++) {
+		tArrayOp seq;
+		size_t n = 20 + gen() % 80;
+		for (size_t i = 0; i < n; i++) seq.push_back(settings.iset[gen() % settings.iset.size()]);
+		std::string fixed = utils::list_as_string(simplify_sequence(settings.sse, seq));
+
+		ArraySink whole, bounded;
+		StreamSimplifier sw(settings.sse, whole, n);
+		StreamSimplifier sb(settings.sse, bounded);
+		for (size_t i = 0; i < n; ) {
+			for (size_t c = 1 + gen() % 7; (c > 0) && (i < n); c--, i++) {
+				sw.push(seq[i]);
+				sb.push(seq[i]);
+			};
+		};
+		sw.flush();
+		sb.flush();
+		if (utils::list_as_string(whole.gates) == fixed) n_exact++;
+		if (utils::list_as_string(bounded.gates) != fixed) n_differ++;
+
+		cx_mat u = eye<cx_mat>(2, 2), v = eye<cx_mat>(2, 2);
+		for (auto &g : seq) u = u * g.matrix;
+		for (auto &g : bounded.gates) v = v * g.matrix;
+		worst = std::max(worst, utils::fowler_distance(u, v));
+	};
+	check("StreamSimplifier", (n_exact == n_seqs) && (worst < 1e-6), to_string(n_exact) + " of " + to_string(n_seqs)
+		+ " chunked streams at the fixed point; default window: " + to_string(n_differ) + " short of it, worst distance "
+		+ sci(worst));
+};
+
+// Product of the gates of a word, as a unitary up to global phase
+cx_mat word_matrix(BasicApproxSettings &settings, const tWord &w) {
+	cx_mat m = eye<cx_mat>(2, 2);
+	for (auto g : w) m = m * settings.iset[g].matrix;
+	return(m);
+};
+
+// Every mined rule keeps the unitary and decreases in shortlex order, so
+// rewriting with them terminates; generation pruned by them matches with
+// the prefix tree
+void check_rule_miner() {
+	BasicApproxSettings mined;
+	init_default_settings(mined);
+	RuleMiner miner(mined, 200);
+	double worst = 0;
+	size_t unordered = 0;
+
+	miner.mine(8, mined.rSet);
+	for (auto &r : miner.rules) {
+		worst = std::max(worst, utils::fowler_distance(word_matrix(mined, r.first), word_matrix(mined, r.second)));
+		if (!shortlex_less(r.second, r.first)) unordered++;
+	};
+	check("RuleMiner rules", !miner.rules.empty() && (worst < 1e-6) && (unordered == 0), to_string(miner.rules.size())
+		+ " rules, worst distance " + sci(worst) + ", " + to_string(unordered) + " not shortlex decreasing");
+
+	int l0 = 10;
+	mined.basic_approxes(l0, mined);
+	PrefixTable pt(mined);
+	pt.generate(l0);
+	tArrayOp tree = pt.to_array();
+	bool same = (tree.size() == mined.approxes.size());
+	for (size_t i = 0; same && (i < tree.size()); i++) same = (tree[i].ancestors == mined.approxes[i].ancestors);
+	check("PrefixTable with mined rules", same, to_string(mined.approxes.size()) + " sequences from basic_approxes, "
+		+ to_string(tree.size()) + " from the prefix tree at l0 = " + to_string(l0));
+};
+
+int main() {
+
+	initOperConstants();
+
+	BasicApproxSettings settings;
+
+	init_default_settings(settings);
+
+	int l0 = 8;
+	settings.basic_approxes(l0, settings);
+
+	check_fixed_dagger(settings);
+	check_clifford_lookup(settings);
+	check_kak_round_trip();
+	check_session(settings);
+	check_simplify_request(settings);
+	check_stream_simplifier(settings);
+	check_planner(settings);
+	check_rule_miner();
+
+	return(n_failed);
+};
@@ -0,0 +1,78 @@
+/* Regression checks of the C interface, compiled as C against libskt.h
+ *
+ * usage: sktcheck_c
+ * Prints one line per check, as sktcheck, and exits with the number of
+ * failed checks.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libskt.h"
+
+static int n_failed = 0;
+
+static void check(const char *name, int ok, const char *detail) {
+	printf("%s %s: %s\n", ok ? "PASS" : "FAIL", name, detail);
+	if (!ok) n_failed++;
+}
+
+/* Rz(a) Ry(b) Rz(c) as 8 doubles, row major (re,im) pairs */
+static void euler_target(double a, double b, double c, double *m) {
+	double w = cos(b / 2) * cos((a + c) / 2), z = cos(b / 2) * sin((a + c) / 2);
+	double y = sin(b / 2) * cos((a - c) / 2), x = -sin(b / 2) * sin((a - c) / 2);
+
+	m[0] = w; m[1] = -z;
+	m[2] = -y; m[3] = -x;
+	m[4] = y; m[5] = -x;
+	m[6] = w; m[7] = z;
+}
+
+int main(void) {
+	enum { n = 20 };
+	double targets[8 * n], errors[n], retry_errors[n], worst = 0;
+	size_t offsets[n + 1], retry_offsets[n + 1], i;
+	uint8_t few[4], *gates;
+	char detail[256];
+	skt_table *t;
+	int r, ids_ok = 1;
+
+	snprintf(detail, sizeof(detail), "%d", skt_abi_version());
+	check("skt_abi_version", skt_abi_version() == SKT_LIB_ABI_VERSION, detail);
+
+	t = skt_open("/nonexistent/skt", 0, 1);
+	snprintf(detail, sizeof(detail), "\"%s\"", skt_last_error());
+	check("skt_open without a table", (t == NULL) && (strlen(skt_last_error()) > 0), detail);
+
+	r = skt_approximate(NULL, targets, n, 1, few, sizeof(few), offsets, NULL);
+	snprintf(detail, sizeof(detail), "status %d, \"%s\"", r, skt_last_error());
+	check("skt_approximate on NULL", r == SKT_LIB_ERROR, detail);
+
+	t = skt_open(NULL, 10, 2);
+	if (t == NULL) {
+		check("skt_open in memory", 0, skt_last_error());
+		return(n_failed);
+	}
+	for (r = 0; r < skt_gate_count(t); r++) ids_ok = ids_ok && (skt_gate_name(t, r) != NULL);
+	ids_ok = ids_ok && (skt_gate_name(t, skt_gate_count(t)) == NULL);
+	snprintf(detail, sizeof(detail), "%d gates, first %s", skt_gate_count(t), skt_gate_name(t, 0));
+	check("skt_gate_name", ids_ok && (skt_gate_count(t) > 0), detail);
+
+	for (i = 0; i < n; i++) euler_target(0.3 * i, 0.17 * i, 0.05 * i, targets + 8 * i);
+	r = skt_approximate(t, targets, n, 2, few, sizeof(few), offsets, errors);
+	snprintf(detail, sizeof(detail), "status %d, %zu gates needed", r, offsets[n]);
+	check("skt_approximate short buffer", (r == SKT_LIB_SHORT_BUFFER) && (offsets[n] > sizeof(few)), detail);
+
+	gates = (uint8_t *)malloc(offsets[n]);
+	r = skt_approximate(t, targets, n, 2, gates, offsets[n], retry_offsets, retry_errors);
+	for (i = 0; i < n; i++) {
+		if (retry_errors[i] > worst) worst = retry_errors[i];
+		if (!isfinite(retry_errors[i])) worst = HUGE_VAL;
+	}
+	snprintf(detail, sizeof(detail), "status %d, %zu gates, worst error %.1e", r, retry_offsets[n], worst);
+	check("skt_approximate", (r == SKT_LIB_OK) && (retry_offsets[n] == offsets[n]) && (worst < 0.1), detail);
+
+	free(gates);
+	skt_close(t);
+	return(n_failed);
+}
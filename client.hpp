@@ -0,0 +1,128 @@
+// Client of the approximation server (see server.hpp, protocol.hpp)
+//
+// send_* queue a request and return its id without waiting, so many
+// requests can be pipelined on one connection; wait(id) returns the answer
+// of a given request, keeping the ones that arrive before it.
+
+#ifndef client_h__
+#define client_h__
+
+#include <map>
+#include <string>
+#include <cstring>
+#include <stdexcept>
+#include "protocol.hpp"
+#include "config.hpp"
+
+class ApproxClient {
+public:
+	int fd;
+	uint32_t next_id;
+	std::map<uint32_t, tWireMessage> arrived;
+
+	ApproxClient(std::string path) {
+		sockaddr_un addr = unix_address(path);
+
+		next_id = 1;
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) throw runtime_error("Cannot create socket");
+		if (connect(fd, (sockaddr *)&addr, sizeof(addr)) < 0) {
+			::close(fd);
+			throw runtime_error("Cannot connect to " + path);
+		};
+	};
+
+	~ApproxClient() {
+		::close(fd);
+	};
+
+	uint32_t send(uint8_t op, const std::string &payload) {
+		tWireHeader hdr = {};
+
+		hdr.op = op;
+		hdr.id = next_id++;
+		if (!write_message(fd, hdr, payload)) throw runtime_error("Connection to server lost");
+		return(hdr.id);
+	};
+
+	uint32_t send_approx(cx_mat target) {
+		double m[8];
+
+		for (int i = 0; i < 4; i++) {
+			m[2 * i] = real(target(i / 2, i % 2));
+			m[2 * i + 1] = imag(target(i / 2, i % 2));
+		};
+		return(send(SKT_OP_APPROX, std::string((const char *)m, sizeof(m))));
+	};
+
+	uint32_t send_simplify(std::string ancestors) {
+		return(send(SKT_OP_SIMPLIFY, ancestors));
+	};
+
+	uint32_t send_stats() {
+		return(send(SKT_OP_STATS, ""));
+	};
+
+	// Next answer off the wire, whatever its id
+	tWireMessage receive() {
+		tWireMessage msg;
+
+		if (!arrived.empty()) {
+			msg = arrived.begin()->second;
+			arrived.erase(arrived.begin());
+			return(msg);
+		};
+		if (!read_message(fd, msg)) throw runtime_error("Connection to server lost");
+		return(msg);
+	};
+
+	tWireMessage wait(uint32_t id) {
+		tWireMessage msg;
+
+		if (arrived.count(id) > 0) {
+			msg = arrived[id];
+			arrived.erase(id);
+		}
+		else {
+			while (true) {
+				if (!read_message(fd, msg)) throw runtime_error("Connection to server lost");
+				if (msg.hdr.id == id) break;
+				arrived[msg.hdr.id] = msg;
+			};
+		};
+		if (msg.hdr.status != SKT_OK) throw runtime_error("Server error: " + msg.payload);
+		return(msg);
+	};
+
+	static tApproxHit decode_approx(tWireMessage &msg) {
+		double dist;
+
+		memcpy(&dist, msg.payload.data(), sizeof(dist));
+		std::string ancs = msg.payload.substr(sizeof(dist));
+		return(make_pair(dist, Oper(ancs, ancs)));
+	};
+
+	static std::pair<size_t, std::string> decode_simplify(tWireMessage &msg) {
+		uint32_t removed;
+
+		memcpy(&removed, msg.payload.data(), sizeof(removed));
+		return(make_pair((size_t)removed, msg.payload.substr(sizeof(removed))));
+	};
+
+	// Blocking helpers
+	tApproxHit approximate(cx_mat target) {
+		tWireMessage msg = wait(send_approx(target));
+		return(decode_approx(msg));
+	};
+
+	std::pair<size_t, std::string> simplify(std::string ancestors) {
+		tWireMessage msg = wait(send_simplify(ancestors));
+		return(decode_simplify(msg));
+	};
+
+	std::string stats() {
+		return(wait(send_stats()).payload);
+	};
+};
+
+#endif // client_h__
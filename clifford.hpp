@@ -0,0 +1,205 @@
+// Clifford-symmetry and global phase reduction of the approximation table
+//
+// U, its 24 Clifford conjugates C U C^dagger and their adjoints are
+// approximated equally well by trivially related sequences, and the global
+// phase is already ignored (T is not in SU(2)). On the quaternion (w,v) of U
+// conjugation rotates v by a signed permutation and the adjoint negates v,
+// so the 48 transforms are the full symmetry group of the cube acting on v.
+// Its fundamental chamber v_x >= v_y >= v_z >= 0 is the canonical region:
+// the table keeps one sequence per orbit, tagged with the transform taking
+// it into the chamber. Two points of the chamber are never closer through
+// another transform, so the nearest canonical entry to the canonical target
+// is the nearest sequence over the whole orbit.
+
+#ifndef clifford_h__
+#define clifford_h__
+
+#include <map>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include "config.hpp"
+
+struct tClifford {
+	std::string word;        // product of the word is the Clifford (H and S = TT)
+	std::string inv_word;
+	tQuat q;
+	int rot[3][3];           // v -> rot v when conjugating by it
+};
+
+// Transform g(U) = C (dagger ? U^dagger : U) C^dagger
+struct tCanonical {
+	tQuat q;                 // quaternion of g(U), inside the chamber
+	int clifford;
+	bool dagger;
+};
+
+struct tCliffordEntry {
+	tQuat q;                 // canonical quaternion
+	std::string ancestors;   // original sequence
+	int clifford;            // transform taking it to q
+	bool dagger;
+};
+
+class CliffordTable: public ApproxLookup {
+public:
+	BasicApproxSettings *settings;
+	std::vector<tClifford> cliffords;
+	std::vector<tCliffordEntry> entries;
+	std::map<tQuatKey, size_t> orbit_index;   // by utils::quaternion_key of the canonical quaternion
+	size_t n_added;
+
+	CliffordTable(BasicApproxSettings &sett) {
+		settings = &sett;
+		n_added = 0;
+		init_cliffords();
+	};
+
+	////////////////////////////////////////////////////////////////////
+	// Sequence helpers, on ancestors strings of the instruction set
+
+	cx_mat sequence_matrix(tArrayOp &seq) {
+		cx_mat m = eye<cx_mat>(2, 2);
+		for (auto op : seq) m = m * op.matrix;
+		return(m);
+	};
+
+	// Sequence of g(U) and of g^-1(U)
+	std::string apply_transform(std::string ancs, int c, bool dagger) {
+		return(cliffords[c].word + (dagger ? settings->dagger_sequence(ancs) : ancs) + cliffords[c].inv_word);
+	};
+
+	std::string apply_inverse(std::string ancs, int c, bool dagger) {
+		std::string inner = cliffords[c].inv_word + ancs + cliffords[c].word;
+		return(dagger ? settings->dagger_sequence(inner) : inner);
+	};
+
+	////////////////////////////////////////////////////////////////////
+	// The 24 Cliffords, breadth first over words in H and S = TT so that
+	// every one gets a shortest word
+	void init_cliffords() {
+		std::deque<std::string> todo = { "" };
+		std::vector<std::string> gens = { "H", "TT" };
+		tQuat id = { 1, 0, 0, 0 };
+
+		cliffords.clear();
+		while (!todo.empty() && (cliffords.size() < 24)) {
+			std::string word = todo.front();
+			todo.pop_front();
+			tQuat q = id;
+			if (!word.empty()) {
+				tArrayOp seq = settings->ancestors_to_array(word);
+				q = utils::su2_quaternion(sequence_matrix(seq));
+			};
+			bool seen = false;
+			for (auto &c : cliffords) seen = seen || (utils::quaternion_distance(c.q, q) < 1e-6);
+			if (seen) continue;
+
+			tClifford c;
+			c.word = word;
+			c.inv_word = word.empty() ? "" : settings->dagger_sequence(word);
+			c.q = q;
+			for (int j = 0; j < 3; j++) {
+				tQuat e = { 0, 0, 0, 0 };
+				e[j + 1] = 1;
+				tQuat r = utils::quaternion_multiply(utils::quaternion_multiply(q, e), utils::quaternion_conjugate(q));
+				for (int i = 0; i < 3; i++) c.rot[i][j] = (int)lround(r[i + 1]);
+			};
+			cliffords.push_back(c);
+			for (auto g : gens) todo.push_back(word + g);
+		};
+		if (cliffords.size() != 24) throw domain_error("Instruction set does not generate the Clifford group");
+	};
+
+	// Signed permutation sorting |v| decreasing with non negative entries.
+	// When its determinant is -1 it is minus a rotation, i.e. the adjoint
+	// followed by a Clifford conjugation.
+	tCanonical canonicalize(tQuat q) {
+		tCanonical can;
+		int p[3] = { 0, 1, 2 };
+		int m[3][3] = { { 0 } };
+		int det;
+
+		std::sort(p, p + 3, [&q](int a, int b) { return(fabs(q[a + 1]) > fabs(q[b + 1])); });
+		det = (((p[0] > p[1]) + (p[0] > p[2]) + (p[1] > p[2])) % 2 == 0) ? 1 : -1;
+		for (int i = 0; i < 3; i++) {
+			int s = (q[p[i] + 1] < 0) ? -1 : 1;
+			m[i][p[i]] = s;
+			det *= s;
+		};
+
+		can.dagger = (det < 0);
+		can.clifford = -1;
+		for (size_t k = 0; k < cliffords.size() && can.clifford < 0; k++) {
+			bool same = true;
+			for (int i = 0; i < 3; i++)
+				for (int j = 0; j < 3; j++)
+					same = same && (cliffords[k].rot[i][j] == (can.dagger ? -m[i][j] : m[i][j]));
+			if (same) can.clifford = (int)k;
+		};
+		can.q[0] = q[0];
+		for (int i = 0; i < 3; i++) can.q[i + 1] = fabs(q[p[i] + 1]);
+		return(can);
+	};
+
+	////////////////////////////////////////////////////////////////////
+	// Keeps op only if its orbit is new or op is shorter than the
+	// representative already stored
+	void add(tOper &op) {
+		tCanonical can = canonicalize(utils::su2_quaternion(op.matrix));
+		tQuatKey key = utils::quaternion_key(can.q);
+		tCliffordEntry e;
+
+		n_added++;
+		e.q = can.q;
+		e.ancestors = op.ancestors;
+		e.clifford = can.clifford;
+		e.dagger = can.dagger;
+		if (orbit_index.count(key) == 0) {
+			orbit_index[key] = entries.size();
+			entries.push_back(e);
+		}
+		else if (entries[orbit_index[key]].ancestors.length() > e.ancestors.length()) {
+			entries[orbit_index[key]] = e;
+		};
+	};
+
+	// Generation keeping only one representative per orbit. The current
+	// generation is still needed in full as prefixes of the next one.
+	void generate(int ll0, BasicApproxSettings &sett) {
+		tArrayOp generation = sett.iset;
+
+		for (auto &op : generation) add(op);
+		for (int l = 2; l <= ll0; l++) {
+			generation = sett.gen_basic_approx_generation(sett, generation);
+			for (auto &op : generation) add(op);
+		};
+		cout << to_string(entries.size()) + " orbit representatives for " + to_string(n_added) + " sequences" << endl;
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		tCanonical can = canonicalize(utils::su2_quaternion(target));
+		double best_dist = HUGE_VAL;
+		size_t best = 0;
+		SKT_PERF_REGION("CliffordTable::lookup");
+
+		if (entries.empty()) return(make_pair(HUGE_VAL, Oper()));
+		for (size_t i = 0; i < entries.size(); i++) {
+			double dist = utils::quaternion_distance(can.q, entries[i].q);
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = i;
+			};
+		};
+
+		// entry -> canonical region -> target
+		tCliffordEntry &e = entries[best];
+		std::string ancs = apply_inverse(apply_transform(e.ancestors, e.clifford, e.dagger), can.clifford, can.dagger);
+		tArrayOp seq = settings->reduce_adjacent(settings->ancestors_to_array(ancs));
+		ancs = utils::list_as_string(seq);
+		return(make_pair(best_dist, Oper(ancs, sequence_matrix(seq), ancs)));
+	};
+};
+
+#endif // clifford_h__
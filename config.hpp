@@ -6,8 +6,39 @@
 #include "basis1.hpp"
 #include "approx.hpp"
 #include "simplify.hpp"
+#include "shard.hpp"
+#include "clifford.hpp"
+#include "sk.hpp"
+#include "planner.hpp"
+#include "rulemine.hpp"
+#include "fixed.hpp"
+#include "prefixtree.hpp"
+#include "curve.hpp"
+#include "zrot.hpp"
+#include "stream.hpp"
+#include "cost.hpp"
+#include "distgen.hpp"
+#include "kak.hpp"
+#include "session.hpp"
 
 int global_count;
 int global_length;
 
+// The H, T, Td instruction set and its simplification rules, shared by the
+// programs and the library. initOperConstants() must have been called.
+void init_default_settings(BasicApproxSettings &settings) {
+	tArrayOp iset2 = { H, T, T_inv };
+	tArrayOp t8 = { T, T, T, T, T, T, T, T };
+	tArrayOp Td8 = { T_inv, T_inv, T_inv, T_inv, T_inv, T_inv, T_inv, T_inv };
+
+	// Simplifying rules
+	ProductFactory pRule;
+	ruleSet rSet = { pRule.Make(0, {}), pRule.Make(1, { H }), pRule.Make(2, {}),
+		pRule.Make(3, t8), pRule.Make(3, Td8) };
+
+	settings.set_iset(iset2);
+	settings.init_simplify_engine(rSet);
+	settings.set_identity(I2);
+};
+
 #endif // config_h__
\ No newline at end of file
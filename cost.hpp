@@ -0,0 +1,142 @@
+// Per gate cost model (e.g. T-count weighted)
+//
+// On fault tolerant hardware a T gate costs far more than a Clifford, so
+// the length of a sequence is a poor measure of it. GateCost gives each
+// instruction a cost, and:
+//  - CostPruner, hooked as the generation filter, drops a sequence when a
+//    sequence of the same unitary (up to phase) and no larger cost is
+//    already in the table; it was produced by an earlier or the same
+//    generation, so its extensions stand for the extensions of the one
+//    dropped. select() does the same on an existing table.
+//  - CostLookup returns, among the entries within epsilon of the target,
+//    the cheapest one (closest first on equal cost), and the nearest entry
+//    when none is within epsilon.
+
+#ifndef cost_h__
+#define cost_h__
+
+#include <map>
+#include <string>
+#include <vector>
+#include "config.hpp"
+
+class GateCost {
+public:
+	BasicApproxSettings *settings;
+	std::map<std::string, double> cost;
+	double default_cost;
+
+	GateCost(BasicApproxSettings &sett, double def) {
+		settings = &sett;
+		default_cost = def;
+	};
+
+	void set(std::string name, double c) {
+		cost[name] = c;
+	};
+
+	double gate(const std::string &name) {
+		std::map<std::string, double>::iterator it = cost.find(name);
+		return((it == cost.end()) ? default_cost : it->second);
+	};
+
+	double sequence(std::string ancs) {
+		double c = 0;
+		for (auto &op : settings->ancestors_to_array(ancs)) c += gate(op.name);
+		return(c);
+	};
+};
+
+// T and Td weigh t_cost, every other instruction 1
+GateCost t_count_cost(BasicApproxSettings &sett, double t_cost) {
+	GateCost gc(sett, 1);
+
+	gc.set("T", t_cost);
+	gc.set("Td", t_cost);
+	return(gc);
+};
+
+class CostPruner {
+public:
+	GateCost *costs;
+	std::map<tQuatKey, double> best;
+	size_t n_pruned;
+
+	CostPruner(GateCost &gc) {
+		costs = &gc;
+		n_pruned = 0;
+	};
+
+	// True if op is the cheapest sequence of its unitary so far
+	bool accept(tOper &op) {
+		tQuatKey key = utils::quaternion_key(op.matrix);
+		double c = costs->sequence(op.ancestors);
+		std::map<tQuatKey, double>::iterator it = best.find(key);
+
+		if ((it != best.end()) && (it->second <= c)) {
+			n_pruned++;
+			return(false);
+		};
+		best[key] = c;
+		return(true);
+	};
+
+	// The instructions are the first sequences of the table
+	void attach(BasicApproxSettings &sett) {
+		best.clear();
+		for (auto &op : sett.iset) accept(op);
+		sett.filter = [this](tOper &op) { return(accept(op)); };
+	};
+
+	void detach(BasicApproxSettings &sett) {
+		sett.filter = nullptr;
+	};
+
+	// Cheapest sequence of each unitary of a table, in table order
+	tArrayOp select(tArrayOp &table) {
+		std::map<tQuatKey, size_t> cheapest;
+		std::vector<double> c(table.size());
+		tArrayOp out;
+
+		for (size_t i = 0; i < table.size(); i++) {
+			tQuatKey key = utils::quaternion_key(table[i].matrix);
+			c[i] = costs->sequence(table[i].ancestors);
+			if ((cheapest.count(key) == 0) || (c[i] < c[cheapest[key]])) cheapest[key] = i;
+		};
+		for (size_t i = 0; i < table.size(); i++) {
+			if (cheapest[utils::quaternion_key(table[i].matrix)] == i) out.push_back(table[i]);
+		};
+		return(out);
+	};
+};
+
+class CostLookup: public ApproxLookup {
+public:
+	CurveTable *table;
+	GateCost *costs;
+	double epsilon;
+	std::vector<double> record_cost;   // cost of each record of the table
+
+	CostLookup(CurveTable &t, GateCost &gc, double eps) {
+		table = &t;
+		costs = &gc;
+		epsilon = eps;
+		for (size_t i = 0; i < t.n_records; i++) record_cost.push_back(gc.sequence(t.record_sequence(i)));
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		std::vector<std::pair<size_t, double> > near;
+		size_t best = 0;
+		SKT_PERF_REGION("CostLookup::lookup");
+
+		table->within(utils::su2_quaternion(target), epsilon, near);
+		if (near.empty()) return(table->lookup(target));
+		for (size_t k = 1; k < near.size(); k++) {
+			double ck = record_cost[near[k].first], cb = record_cost[near[best].first];
+			if ((ck < cb) || ((ck == cb) && (near[k].second < near[best].second))) best = k;
+		};
+		return(table->record_hit(near[best].first, near[best].second));
+	};
+};
+
+#endif // cost_h__
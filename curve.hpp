@@ -0,0 +1,285 @@
+// Approximation table laid out along a space filling curve over S^3
+//
+// Entries sorted in generation order sit anywhere on SU(2), so a nearest
+// neighbour search touches the whole table. Here the canonical quaternions
+// (w >= 0) are quantized to 16 bits per coordinate and sorted by their
+// Morton or Hilbert key: nearby unitaries are nearby in memory. Blocks of
+// block_size consecutive entries carry a bounding box, and the lookup scans
+// only the blocks whose box is within the best distance found so far,
+// starting from the block of the target's own key and prefetching the next
+// candidate block while scanning the current one. The records live in one
+// mapping backed by huge pages when possible (MAP_HUGETLB, else
+// madvise(MADV_HUGEPAGE) for transparent huge pages).
+
+#ifndef curve_h__
+#define curve_h__
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sys/mman.h>
+#include "config.hpp"
+
+enum tCurveOrder { CURVE_NONE = 0, CURVE_MORTON = 1, CURVE_HILBERT = 2 };
+
+struct tCurveRecord {
+	double q[4];             // canonical quaternion
+	uint64_t key;            // curve key of q
+	uint32_t seq_off;        // ancestors string, offset in the blob
+	uint32_t seq_len;
+};
+
+struct tCurveBlock {
+	double lo[4], hi[4];     // bounding box of the quaternions of the block
+	uint64_t begin, end;     // records [begin, end)
+};
+
+const size_t huge_page_bytes = 2 * 1024 * 1024;
+
+// Anonymous mapping, on explicit huge pages if the system has some
+// reserved, else asking for transparent ones. huge is set to what was got.
+void *huge_alloc(size_t bytes, size_t &mapped, bool &huge) {
+	void *base = MAP_FAILED;
+
+	mapped = (bytes + huge_page_bytes - 1) / huge_page_bytes * huge_page_bytes;
+	huge = false;
+#ifdef MAP_HUGETLB
+	base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	huge = (base != MAP_FAILED);
+#endif
+	if (base == MAP_FAILED) {
+		base = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED) throw runtime_error("Cannot map " + to_string(mapped) + " bytes");
+#ifdef MADV_HUGEPAGE
+		madvise(base, mapped, MADV_HUGEPAGE);
+#endif
+	};
+	return(base);
+};
+
+// Coordinates of a canonical quaternion on a 2^bits grid, w in [0,1] and
+// x,y,z in [-1,1]
+void curve_coordinates(tQuat q, int bits, uint32_t *x) {
+	double scale = (double)((1u << bits) - 1);
+
+	x[0] = (uint32_t)llround(std::min(1.0, std::max(0.0, q[0])) * scale);
+	for (int i = 1; i < 4; i++) x[i] = (uint32_t)llround(std::min(1.0, std::max(0.0, (q[i] + 1) / 2)) * scale);
+};
+
+uint64_t interleave_bits(const uint32_t *x, int bits) {
+	uint64_t key = 0;
+
+	for (int b = bits - 1; b >= 0; b--)
+		for (int i = 0; i < 4; i++) key = (key << 1) | ((x[i] >> b) & 1);
+	return(key);
+};
+
+uint64_t morton_key(tQuat q, int bits) {
+	uint32_t x[4];
+
+	curve_coordinates(q, bits, x);
+	return(interleave_bits(x, bits));
+};
+
+// Skilling's transform of the coordinates into the transposed Hilbert
+// index, then bit interleaving
+uint64_t hilbert_key(tQuat q, int bits) {
+	uint32_t x[4], m = 1u << (bits - 1), t;
+
+	curve_coordinates(q, bits, x);
+	for (uint32_t Q = m; Q > 1; Q >>= 1) {
+		uint32_t P = Q - 1;
+		for (int i = 0; i < 4; i++) {
+			if (x[i] & Q) x[0] ^= P;
+			else {
+				t = (x[0] ^ x[i]) & P;
+				x[0] ^= t;
+				x[i] ^= t;
+			};
+		};
+	};
+	for (int i = 1; i < 4; i++) x[i] ^= x[i - 1];
+	t = 0;
+	for (uint32_t Q = m; Q > 1; Q >>= 1) if (x[3] & Q) t ^= Q - 1;
+	for (int i = 0; i < 4; i++) x[i] ^= t;
+	return(interleave_bits(x, bits));
+};
+
+class CurveTable: public ApproxLookup {
+public:
+	tCurveOrder order;
+	int bits;
+	size_t block_size;
+	tCurveRecord *records;
+	size_t n_records;
+	size_t mapped_bytes;
+	bool huge_pages;
+	std::vector<tCurveBlock> blocks;
+	std::string blob;
+
+	CurveTable(tCurveOrder o, size_t bs) {
+		order = o;
+		bits = 16;
+		block_size = bs;
+		records = NULL;
+		n_records = 0;
+		mapped_bytes = 0;
+		huge_pages = false;
+	};
+
+	// records is mapped and unmapped by this table alone
+	CurveTable(const CurveTable &) = delete;
+	CurveTable &operator=(const CurveTable &) = delete;
+
+	~CurveTable() {
+		clear();
+	};
+
+	void clear() {
+		if (records != NULL) munmap(records, mapped_bytes);
+		records = NULL;
+		n_records = 0;
+		blocks.clear();
+		blob.clear();
+	};
+
+	uint64_t curve_key(tQuat q) {
+		if (order == CURVE_MORTON) return(morton_key(q, bits));
+		if (order == CURVE_HILBERT) return(hilbert_key(q, bits));
+		return(0);
+	};
+
+	void build(tArrayOp &table) {
+		std::vector<tCurveRecord> recs(table.size());
+
+		clear();
+		for (size_t i = 0; i < table.size(); i++) {
+			tQuat q = utils::su2_quaternion(table[i].matrix);
+			for (int k = 0; k < 4; k++) recs[i].q[k] = q[k];
+			recs[i].key = curve_key(q);
+			recs[i].seq_off = (uint32_t)blob.size();
+			recs[i].seq_len = (uint32_t)table[i].ancestors.length();
+			blob += table[i].ancestors;
+		};
+		// stable: CURVE_NONE keeps the generation order
+		std::stable_sort(recs.begin(), recs.end(), [](const tCurveRecord &a, const tCurveRecord &b) { return(a.key < b.key); });
+
+		n_records = recs.size();
+		records = (tCurveRecord *)huge_alloc(std::max((size_t)1, n_records) * sizeof(tCurveRecord), mapped_bytes, huge_pages);
+		std::copy(recs.begin(), recs.end(), records);
+
+		for (size_t b = 0; b < n_records; b += block_size) {
+			tCurveBlock blk;
+			blk.begin = b;
+			blk.end = std::min(n_records, b + block_size);
+			for (int k = 0; k < 4; k++) {
+				blk.lo[k] = records[b].q[k];
+				blk.hi[k] = records[b].q[k];
+			};
+			for (size_t i = b; i < blk.end; i++) {
+				for (int k = 0; k < 4; k++) {
+					blk.lo[k] = std::min(blk.lo[k], records[i].q[k]);
+					blk.hi[k] = std::max(blk.hi[k], records[i].q[k]);
+				};
+			};
+			blocks.push_back(blk);
+		};
+#ifdef _DEBUG
+		cout << "CurveTable: " + to_string(n_records) + " entries, " + to_string(blocks.size()) + " blocks"
+			+ (huge_pages ? ", huge pages" : "") << endl;
+#endif
+	};
+
+	// Same test as shard_within, on a block
+	bool block_within(const tCurveBlock &blk, tQuat q, double dist) {
+		tQuat mq = { -q[0], -q[1], -q[2], -q[3] };
+		double r2 = 2 * dist * dist;
+		return((box_distance2(q, blk.lo, blk.hi) <= r2) || (box_distance2(mq, blk.lo, blk.hi) <= r2));
+	};
+
+	void prefetch_block(const tCurveBlock &blk) {
+		const char *p = (const char *)(records + blk.begin);
+		const char *end = (const char *)(records + blk.end);
+		for (; p < end; p += 64) __builtin_prefetch(p);
+	};
+
+	void scan_block(const tCurveBlock &blk, tQuat q, double &best_dist, size_t &best) {
+		for (size_t i = blk.begin; i < blk.end; i++) {
+			tQuat p = { records[i].q[0], records[i].q[1], records[i].q[2], records[i].q[3] };
+			double dist = utils::quaternion_distance(q, p);
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = i;
+			};
+		};
+	};
+
+	// Next block after i still within the best distance, or blocks.size()
+	size_t next_candidate(size_t i, size_t skip, tQuat q, double best_dist) {
+		for (i++; i < blocks.size(); i++) {
+			if (i + 8 < blocks.size()) __builtin_prefetch(&blocks[i + 8]);
+			if ((i != skip) && block_within(blocks[i], q, best_dist)) return(i);
+		};
+		return(i);
+	};
+
+	// Records within dist of q, with their distances
+	void within(tQuat q, double dist, std::vector<std::pair<size_t, double> > &out) {
+		out.clear();
+		for (size_t b = 0; b < blocks.size(); b++) {
+			if (!block_within(blocks[b], q, dist)) continue;
+			for (size_t i = blocks[b].begin; i < blocks[b].end; i++) {
+				tQuat p = { records[i].q[0], records[i].q[1], records[i].q[2], records[i].q[3] };
+				double d = utils::quaternion_distance(q, p);
+				if (d <= dist) out.push_back(make_pair(i, d));
+			};
+		};
+	};
+
+	std::string record_sequence(size_t i) {
+		return(blob.substr(records[i].seq_off, records[i].seq_len));
+	};
+
+	tApproxHit record_hit(size_t i, double dist) {
+		tQuat p = { records[i].q[0], records[i].q[1], records[i].q[2], records[i].q[3] };
+		std::string ancs = record_sequence(i);
+		return(make_pair(dist, Oper(ancs, utils::quaternion_matrix(p), ancs)));
+	};
+
+	// Nearest record to q, if nearer than best_dist on entry: a caller with a
+	// candidate already (best, best_dist) prunes the blocks from the start
+	void search(tQuat q, double &best_dist, size_t &best) {
+		size_t home = 0;
+
+		// The block holding the target's key gives a first, usually close, bound
+		if (order != CURVE_NONE) {
+			uint64_t key = curve_key(q);
+			size_t pos = std::lower_bound(records, records + n_records, key,
+				[](const tCurveRecord &r, uint64_t k) { return(r.key < k); }) - records;
+			home = std::min(pos, n_records - 1) / block_size;
+		};
+		scan_block(blocks[home], q, best_dist, best);
+
+		size_t i = next_candidate((size_t)-1, home, q, best_dist);
+		while (i < blocks.size()) {
+			size_t next = next_candidate(i, home, q, best_dist);
+			if (next < blocks.size()) prefetch_block(blocks[next]);
+			if (block_within(blocks[i], q, best_dist)) scan_block(blocks[i], q, best_dist, best);
+			i = next;
+		};
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		tQuat q = utils::su2_quaternion(target);
+		double best_dist = HUGE_VAL;
+		size_t best = 0;
+		SKT_PERF_REGION("CurveTable::lookup");
+
+		if (n_records == 0) return(make_pair(HUGE_VAL, Oper()));
+		search(q, best_dist, best);
+		return(record_hit(best, best_dist));
+	};
+};
+
+#endif // curve_h__
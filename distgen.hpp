@@ -0,0 +1,314 @@
+// Multi-process generation of a sharded table, with a merge step
+//
+// Level l is built from level l-1 by n workers and n mergers that only
+// share a directory (one host forking them, or several hosts on a shared
+// filesystem). Sequences travel as frontier files (shard.hpp), split in n
+// buckets by the hash of their unitary key:
+//
+//   worker w  : parents of level_<l-1>_<b>.frt (all b) whose ancestors hash
+//               to w -> children, deduplicated by unitary within the worker
+//               -> part_<l>_<w>_<bucket>.frt
+//   merger b  : part_<l>_<w>_<b>.frt (all w) -> one sequence per unitary not
+//               already in keys_<l-1>_<b>.bin (earlier levels), the one with
+//               fewest gates winning -> level_<l>_<b>.frt, keys_<l>_<b>.bin
+//   finalize  : every level file -> ShardWriter -> shard files and index
+//
+// A unitary lives in a single bucket, so each merger dedups globally on its
+// own, and the winner does not depend on how parents were split. Dropping a
+// sequence whose unitary is already known also drops its extensions: they
+// are the extensions of the kept one.
+//
+// A merger writes its files under a temporary name and renames them, the
+// count file last; the parts are removed after it. Run again, it recomputes
+// the same level from the parts, or returns the count of a finished merge.
+// The count file starts with the level and the number of buckets, and one
+// written for another split is not taken as finished; init_level() removes
+// the files of the levels above 1 left by an earlier generation.
+
+#ifndef distgen_h__
+#define distgen_h__
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "config.hpp"
+
+// FNV-1a: the same on every host and build, unlike std::hash
+uint64_t fnv1a(const void *data, size_t n) {
+	const unsigned char *p = (const unsigned char *)data;
+	uint64_t h = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < n; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	};
+	return(h);
+};
+
+class DistributedGenerator {
+public:
+	BasicApproxSettings *settings;
+	std::string dir;
+	int n_shards;
+
+	DistributedGenerator(BasicApproxSettings &sett, std::string d, int n) {
+		settings = &sett;
+		dir = d;
+		n_shards = n;
+	};
+
+	int bucket(const tQuatKey &key) {
+		return((int)(fnv1a(key.data(), sizeof(key)) % n_shards));
+	};
+
+	int owner(const std::string &ancs) {
+		return((int)(fnv1a(ancs.data(), ancs.size()) % n_shards));
+	};
+
+	// Fewer gates first, then alphabetical: independent of arrival order
+	bool better(const tOper &a, const tOper &b) {
+		size_t la = settings->ancestors_to_array(a.ancestors).size();
+		size_t lb = settings->ancestors_to_array(b.ancestors).size();
+
+		if (la != lb) return(la < lb);
+		return(a.ancestors < b.ancestors);
+	};
+
+	std::string level_path(int l, int b) {
+		return(dir + "/level_" + to_string(l) + "_" + to_string(b) + ".frt");
+	};
+
+	std::string part_path(int l, int w, int b) {
+		return(dir + "/part_" + to_string(l) + "_" + to_string(w) + "_" + to_string(b) + ".frt");
+	};
+
+	// Keys of the unitaries of levels 1 .. l in bucket b
+	std::string keys_path(int l, int b) {
+		return(dir + "/keys_" + to_string(l) + "_" + to_string(b) + ".bin");
+	};
+
+	std::string count_path(int l, int b) {
+		return(dir + "/level_" + to_string(l) + "_" + to_string(b) + ".cnt");
+	};
+
+	// "<l> <n_shards> <sequences>": the count of a finished merge
+	void write_count(ofstream &out, int l, size_t n) {
+		out << l << " " << n_shards << " " << n << endl;
+	};
+
+	// False if the count file is missing, partial or from another split
+	bool read_count(int l, int b, size_t &n) {
+		int fl = 0, fn = 0;
+		ifstream in(count_path(l, b));
+
+		if (!(in >> fl >> fn >> n)) return(false);
+		return((fl == l) && (fn == n_shards));
+	};
+
+	void remove_level(int l) {
+		for (int b = 0; b < n_shards; b++) {
+			remove(keys_path(l, b).c_str());
+			remove(level_path(l, b).c_str());
+			remove(count_path(l, b).c_str());
+		};
+	};
+
+	bool level_exists(int l) {
+		for (int b = 0; b < n_shards; b++) {
+			if (ifstream(count_path(l, b)) || ifstream(level_path(l, b))) return(true);
+		};
+		return(false);
+	};
+
+	std::set<tQuatKey> read_keys(int l, int b) {
+		std::set<tQuatKey> keys;
+		tQuatKey k;
+		ifstream in(keys_path(l, b), ios::binary);
+
+		while (in.read((char *)k.data(), sizeof(k))) keys.insert(k);
+		return(keys);
+	};
+
+	void rename_file(std::string from, std::string to) {
+		if (rename(from.c_str(), to.c_str()) != 0) throw runtime_error("Cannot rename " + from + " to " + to);
+	};
+
+	// Writes a bucketed set of sequences as level l (or as a worker's parts)
+	void write_buckets(std::map<tQuatKey, tOper> &ops, std::vector<std::string> paths) {
+		std::vector<ofstream> outs;
+
+		for (auto &p : paths) {
+			outs.emplace_back(p, ios::binary | ios::trunc);
+			if (!outs.back()) throw runtime_error("Cannot write " + p);
+		};
+		for (auto &e : ops) write_frontier_op(outs[bucket(e.first)], e.second);
+	};
+
+	// Level 1: the instructions, merged directly. The levels of an earlier
+	// generation in dir are removed: their merges would look finished.
+	void init_level() {
+		std::map<tQuatKey, tOper> ops;
+
+		for (int l = 2; level_exists(l); l++) remove_level(l);
+		for (auto insn : settings->iset) {
+			tQuatKey k = utils::quaternion_key(insn.matrix);
+			if ((ops.count(k) == 0) || better(insn, ops[k])) ops[k] = insn;
+		};
+		for (int b = 0; b < n_shards; b++) {
+			ofstream keys(keys_path(1, b), ios::binary | ios::trunc);
+			ofstream level(level_path(1, b), ios::binary | ios::trunc);
+			ofstream count(count_path(1, b), ios::trunc);
+			size_t n = 0;
+			for (auto &e : ops) {
+				if (bucket(e.first) != b) continue;
+				keys.write((const char *)e.first.data(), sizeof(e.first));
+				write_frontier_op(level, e.second);
+				n++;
+			};
+			write_count(count, 1, n);
+		};
+	};
+
+	void worker(int l, int w) {
+		std::map<tQuatKey, tOper> children;
+		std::vector<std::string> paths;
+		tOper prefix;
+
+		for (int b = 0; b < n_shards; b++) {
+			ifstream in(level_path(l - 1, b), ios::binary);
+			while (read_frontier_op(in, prefix)) {
+				if (owner(prefix.ancestors) != w) continue;
+				tArrayOp s2 = {};
+				settings->gen_basic_approx_children(*settings, prefix, s2);
+				for (auto &child : s2) {
+					tQuatKey k = utils::quaternion_key(child.matrix);
+					std::map<tQuatKey, tOper>::iterator it = children.find(k);
+					if (it == children.end()) children[k] = child;
+					else if (better(child, it->second)) it->second = child;
+				};
+			};
+		};
+		for (int b = 0; b < n_shards; b++) paths.push_back(part_path(l, w, b));
+		write_buckets(children, paths);
+	};
+
+	size_t merge(int l, int b) {
+		std::map<tQuatKey, tOper> winners;
+		tOper op;
+		size_t done;
+
+		if (read_count(l, b, done)) {
+			for (int w = 0; w < n_shards; w++) remove(part_path(l, w, b).c_str());
+			return(done);
+		};
+		std::set<tQuatKey> known = read_keys(l - 1, b);
+		for (int w = 0; w < n_shards; w++) {
+			ifstream in(part_path(l, w, b), ios::binary);
+			if (!in) throw runtime_error("Missing " + part_path(l, w, b));
+			while (read_frontier_op(in, op)) {
+				tQuatKey k = utils::quaternion_key(op.matrix);
+				if (known.count(k) > 0) continue;
+				std::map<tQuatKey, tOper>::iterator it = winners.find(k);
+				if (it == winners.end()) winners[k] = op;
+				else if (better(op, it->second)) it->second = op;
+			};
+		};
+
+		{
+			ofstream keys(keys_path(l, b) + ".tmp", ios::binary | ios::trunc);
+			ofstream level(level_path(l, b) + ".tmp", ios::binary | ios::trunc);
+			for (auto &k : known) keys.write((const char *)k.data(), sizeof(k));
+			for (auto &e : winners) {
+				keys.write((const char *)e.first.data(), sizeof(e.first));
+				write_frontier_op(level, e.second);
+			};
+			ofstream count(count_path(l, b) + ".tmp", ios::trunc);
+			write_count(count, l, winners.size());
+			if (!keys || !level || !count) throw runtime_error("Cannot write level " + to_string(l) + " bucket " + to_string(b));
+		}
+		rename_file(keys_path(l, b) + ".tmp", keys_path(l, b));
+		rename_file(level_path(l, b) + ".tmp", level_path(l, b));
+		rename_file(count_path(l, b) + ".tmp", count_path(l, b));
+		for (int w = 0; w < n_shards; w++) remove(part_path(l, w, b).c_str());
+		return(winners.size());
+	};
+
+	size_t level_count(int l) {
+		size_t total = 0;
+
+		for (int b = 0; b < n_shards; b++) {
+			size_t n = 0;
+			if (read_count(l, b, n)) total += n;
+		};
+		return(total);
+	};
+
+	// Every level into the shards and the index
+	void finalize(int ll0, ShardWriter &writer) {
+		tOper op;
+
+		for (int l = 1; l <= ll0; l++) {
+			for (int b = 0; b < n_shards; b++) {
+				ifstream in(level_path(l, b), ios::binary);
+				while (read_frontier_op(in, op)) writer.add(op);
+			};
+		};
+		writer.finalize();
+	};
+
+	// Removes the level, key and count files
+	void cleanup(int ll0) {
+		for (int l = 1; l <= ll0; l++) remove_level(l);
+	};
+
+	// Runs job(i) for i < n_shards in forked processes and waits for them
+	void fork_all(std::function<void(int)> job, std::string what) {
+		std::vector<pid_t> pids;
+		bool failed = false;
+
+		cout.flush();
+		for (int i = 0; i < n_shards; i++) {
+			pid_t pid = fork();
+			if (pid < 0) throw runtime_error("Cannot fork " + what);
+			if (pid == 0) {
+				int status = 0;
+				try {
+					job(i);
+				}
+				catch (exception &e) {
+					cerr << what + " " + to_string(i) + ": " + e.what() << endl;
+					status = 1;
+				};
+				cout.flush();
+				_exit(status);
+			};
+			pids.push_back(pid);
+		};
+		for (auto pid : pids) {
+			int status;
+			if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) failed = true;
+		};
+		if (failed) throw runtime_error(what + " failed");
+	};
+
+	// The whole generation on this machine, n_shards workers at a time
+	void run_local(int ll0, ShardWriter &writer) {
+		init_level();
+		for (int l = 2; l <= ll0; l++) {
+			fork_all([this, l](int w) { worker(l, w); }, "worker");
+			fork_all([this, l](int b) { merge(l, b); }, "merger");
+			cout << "Generation " + to_string(l) + ": " + to_string(level_count(l)) + " sequences" << endl;
+		};
+		finalize(ll0, writer);
+		cleanup(ll0);
+	};
+};
+
+#endif // distgen_h__
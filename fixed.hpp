@@ -0,0 +1,168 @@
+// Fixed size operators for small dimensions (qubit, qutrit, two qubits, ...)
+//
+// cx_mat keeps its size at run time and allocates on the heap, which
+// dominates the 2x2 to 8x8 products and distances of table generation.
+// tFixedMat<D> is a row major D x D array on the stack; its loops have
+// compile time bounds, so the compiler unrolls them. FixedOper<D> is the
+// matching Oper, and the bases and metrics of SU(d) have fixed versions
+// built from the dynamic ones. tOperFor<D>::type picks FixedOper<D> up to
+// fixed_max_dimension and the dynamic Oper above it.
+
+#ifndef fixed_h__
+#define fixed_h__
+
+#include <complex>
+#include <string>
+#include <vector>
+#include "config.hpp"
+
+const int fixed_max_dimension = 8;
+
+template<int D> struct tFixedMat {
+	complex<double> a[D * D];
+
+	complex<double> &operator()(int i, int j) {
+		return(a[i * D + j]);
+	};
+
+	const complex<double> &operator()(int i, int j) const {
+		return(a[i * D + j]);
+	};
+
+	static tFixedMat eye() {
+		tFixedMat m;
+		for (int i = 0; i < D * D; i++) m.a[i] = (i % (D + 1) == 0) ? 1.0 : 0.0;
+		return(m);
+	};
+
+	static tFixedMat from(const cx_mat &m) {
+		tFixedMat f;
+		assert(((int)m.n_rows == D) && ((int)m.n_cols == D));
+		for (int i = 0; i < D; i++)
+			for (int j = 0; j < D; j++) f(i, j) = m(i, j);
+		return(f);
+	};
+
+	cx_mat to_mat() const {
+		cx_mat m(D, D);
+		for (int i = 0; i < D; i++)
+			for (int j = 0; j < D; j++) m(i, j) = (*this)(i, j);
+		return(m);
+	};
+};
+
+template<int D> void fixed_multiply(const tFixedMat<D> &A, const tFixedMat<D> &B, tFixedMat<D> &C) {
+	for (int i = 0; i < D; i++) {
+		for (int j = 0; j < D; j++) {
+			complex<double> s = 0;
+			for (int k = 0; k < D; k++) s += A(i, k) * B(k, j);
+			C(i, j) = s;
+		};
+	};
+};
+
+template<int D> tFixedMat<D> fixed_adjoint(const tFixedMat<D> &A) {
+	tFixedMat<D> C;
+	for (int i = 0; i < D; i++)
+		for (int j = 0; j < D; j++) C(i, j) = conj(A(j, i));
+	return(C);
+};
+
+// tr(A^dagger B)
+template<int D> complex<double> fixed_trace_product(const tFixedMat<D> &A, const tFixedMat<D> &B) {
+	complex<double> tr = 0;
+	for (int i = 0; i < D * D; i++) tr += conj(A.a[i]) * B.a[i];
+	return(tr);
+};
+
+// Same value as utils::fowler_distance
+template<int D> double fixed_fowler_distance(const tFixedMat<D> &A, const tFixedMat<D> &B) {
+	SKT_PERF_COUNT("fixed_fowler_distance");
+	return(sqrt(fabs((D - abs(fixed_trace_product(A, B))) / D)));
+};
+
+// Same value as utils::trace_norm
+template<int D> double fixed_trace_norm(const tFixedMat<D> &A) {
+	return(sqrt(real(fixed_trace_product(A, A))));
+};
+
+template<int D> class FixedOper {
+public:
+	tFixedMat<D> matrix;
+	std::string name;
+	std::string ancestors;
+
+	FixedOper() {
+	};
+
+	FixedOper(std::string n, const tFixedMat<D> &m, std::string anc) {
+		name = n;
+		matrix = m;
+		ancestors = anc;
+	};
+
+	FixedOper(const Oper &op) {
+		name = op.name;
+		matrix = tFixedMat<D>::from(op.matrix);
+		ancestors = op.ancestors;
+	};
+
+	Oper to_oper() const {
+		return(Oper(name, matrix.to_mat(), ancestors));
+	};
+
+	FixedOper multiply(const FixedOper &other, std::string new_name) const {
+		FixedOper r;
+		fixed_multiply(matrix, other.matrix, r.matrix);
+		r.name = new_name;
+		r.ancestors = ancestors + other.ancestors;
+		return(r);
+	};
+
+	// Gates of the sequence reversed and each replaced by its adjoint, as in
+	// BasicApproxSettings::dagger_sequence; named by its ancestors like SKApprox::dagger
+	FixedOper dagger(BasicApproxSettings &settings) const {
+		std::string ancs = settings.dagger_sequence(ancestors);
+		return(FixedOper(ancs, fixed_adjoint(matrix), ancs));
+	};
+};
+
+// Product of the gates of an ancestors string, first gate on the left
+template<int D> tFixedMat<D> fixed_sequence_matrix(BasicApproxSettings &settings, std::string ancs) {
+	tFixedMat<D> m = tFixedMat<D>::eye(), t;
+
+	for (auto &op : settings.ancestors_to_array(ancs)) {
+		fixed_multiply(m, tFixedMat<D>::from(op.matrix), t);
+		m = t;
+	};
+	return(m);
+};
+
+template<int D, bool small = (D <= fixed_max_dimension)> struct tOperFor {
+	typedef FixedOper<D> type;
+};
+
+template<int D> struct tOperFor<D, false> {
+	typedef Oper type;
+};
+
+////////////////////////////////////////////////////////////////////
+// Bases of SU(D), converted once from the dynamic ones
+
+template<int D> std::vector<FixedOper<D> > fixed_hermitian_basis() {
+	std::vector<FixedOper<D> > out;
+	Basis b = get_hermitian_basis(D);
+
+	for (auto &e : b.elB) out.push_back(FixedOper<D>(e.second));
+	return(out);
+};
+
+template<int D> std::vector<FixedOper<D> > fixed_unitary_basis() {
+	std::vector<FixedOper<D> > out;
+	Basis b = get_unitary_basis(D);
+
+	for (auto &e : b.uB) out.push_back(FixedOper<D>(e.second));
+	return(out);
+};
+
+#endif // fixed_h__
@@ -0,0 +1,289 @@
+// Two qubit synthesis: KAK decomposition and a batched single qubit stage
+//
+// Up to phase, every U in U(4) is (a0 x a1) exp(i (c0 XX + c1 YY + c2 ZZ)) (b0 x b1).
+// In the magic basis B, local gates are real orthogonal and XX, YY, ZZ are
+// diagonal. So, with Ub = B^dagger U B / det(U)^(1/4), the matrix M = Ub^T Ub
+// is symmetric unitary. Its real and imaginary parts commute, and one real
+// orthogonal P (eigenvectors of Re M + r Im M for a generic r) diagonalizes
+// both: M = P diag(e^{2i theta}) P^T and Ub = K diag(e^{i theta}) P^T, with K
+// real orthogonal. The interaction takes 3 CNOTs (Vatan-Williams). A target
+// therefore becomes 4 layers of 2 single qubit factors around 3 CNOTs.
+//
+// TwoQubitCompiler::compile takes a whole batch of targets. It gathers the 8
+// factors of every target and dedups them by unitary. Each distinct factor is
+// approximated once with SK, on n_threads threads. Qubit 0 is the left factor
+// of kron, so CNOT(0) maps |10> to |11>.
+
+#ifndef kak_h__
+#define kak_h__
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.hpp"
+
+struct tKAK {
+	cx_mat a[2], b[2];       // local factors after and before the interaction, qubit 0 and 1
+	double c[3];             // interaction exp(i (c0 XX + c1 YY + c2 ZZ))
+};
+
+struct tTwoQubitCircuit {
+	cx_mat local[4][2];          // single qubit factors of layer 0..3 (layer 0 first in time)
+	int control[3];              // control qubit of CNOT k, between layers k and k+1
+	std::string sequence[4][2];  // approximations of the factors, set by compile()
+	cx_mat matrix;               // the approximated circuit
+	double error;                // fowler distance to the target
+};
+
+// Columns (|00> + |11>)/sqrt2, i(|01> + |10>)/sqrt2, (|01> - |10>)/sqrt2, i(|00> - |11>)/sqrt2
+cx_mat magic_basis() {
+	complex<double> s = 1 / sqrt(2.0), is(0, 1 / sqrt(2.0));
+	cx_mat B(4, 4);
+
+	B.zeros();
+	B(0, 0) = s; B(3, 0) = s;
+	B(1, 1) = is; B(2, 1) = is;
+	B(1, 2) = s; B(2, 2) = -s;
+	B(0, 3) = is; B(3, 3) = -is;
+	return(B);
+};
+
+cx_mat cnot_matrix(int control) {
+	cx_mat m(4, 4);
+	int a = (control == 0) ? 2 : 1;      // |10> or |01>, swapped with |11>
+
+	m.zeros();
+	for (int i = 0; i < 4; i++) if ((i != a) && (i != 3)) m(i, i) = 1;
+	m(a, 3) = 1;
+	m(3, a) = 1;
+	return(m);
+};
+
+cx_mat rz_matrix(double t) {
+	tQuat q = { cos(t / 2), 0, 0, sin(t / 2) };
+	return(utils::quaternion_matrix(q));
+};
+
+cx_mat ry_matrix(double t) {
+	tQuat q = { cos(t / 2), 0, sin(t / 2), 0 };
+	return(utils::quaternion_matrix(q));
+};
+
+// L = a x b with a, b in SU(2), from the 2x2 block of L with the largest norm
+void split_local(const cx_mat &L, cx_mat &a, cx_mat &b) {
+	int bi = 0, bj = 0;
+	double best = -1;
+
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			double n = 0;
+			for (int k = 0; k < 2; k++)
+				for (int l = 0; l < 2; l++) n += std::norm(L(2 * i + k, 2 * j + l));
+			if (n > best) {
+				best = n;
+				bi = i;
+				bj = j;
+			};
+		};
+	};
+	b.set_size(2, 2);
+	for (int k = 0; k < 2; k++)
+		for (int l = 0; l < 2; l++) b(k, l) = L(2 * bi + k, 2 * bj + l);
+	b = b / sqrt(det(b));
+	a.set_size(2, 2);
+	for (int i = 0; i < 2; i++) {
+		for (int j = 0; j < 2; j++) {
+			complex<double> t = 0;
+			for (int k = 0; k < 2; k++)
+				for (int l = 0; l < 2; l++) t += conj(b(k, l)) * L(2 * i + k, 2 * j + l);
+			a(i, j) = t / 2.0;
+		};
+	};
+	// a x b = (ia) x (-ib): keep both in SU(2)
+	if (real(det(a)) < 0) {
+		a = a * complex<double>(0, 1);
+		b = b * complex<double>(0, -1);
+	};
+};
+
+tKAK kak_decompose(cx_mat U) {
+	cx_mat B = magic_basis();
+	cx_mat Ub = B.t() * U * B;
+	cx_mat M, P(4, 4), K, D(4, 4);
+	mat S(4, 4), V;
+	vec eigval;
+	complex<double> d = det(U);
+	double theta[4], sum = 0;
+	tKAK kak;
+
+	Ub = Ub / pow(d, 0.25);
+	M = Ub.st() * Ub;
+
+	// Re M and Im M commute: a generic combination has their common eigenvectors
+	const double mix[3] = { 0.6180339887, 1.4142135624, -2.7182818285 };
+	for (int attempt = 0; attempt < 3; attempt++) {
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++) S(i, j) = real(M(i, j)) + mix[attempt] * imag(M(i, j));
+		eig_sym(eigval, V, S);
+		double off = 0;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++) {
+				complex<double> e = 0;
+				for (int k = 0; k < 4; k++)
+					for (int l = 0; l < 4; l++) e += V(k, i) * M(k, l) * V(l, j);
+				if (i != j) off += abs(e);
+				else D(i, i) = e;
+			};
+		};
+		if (off < 1e-9) break;
+		if (attempt == 2) throw runtime_error("kak_decompose: cannot diagonalize");
+	};
+	for (int i = 0; i < 4; i++)
+		for (int j = 0; j < 4; j++) P(i, j) = V(i, j);
+	if (real(det(P)) < 0) for (int i = 0; i < 4; i++) P(i, 0) = -P(i, 0);
+
+	for (int k = 0; k < 4; k++) {
+		theta[k] = arg(D(k, k)) / 2;
+		sum += theta[k];
+	};
+	// det M = 1 makes the sum a multiple of pi; det K = 1 needs a multiple of 2 pi
+	if (fmod(fabs(sum) + datum::pi / 2, 2 * datum::pi) > datum::pi) theta[0] += datum::pi;
+
+	cx_mat A(4, 4), Ainv(4, 4);
+	A.zeros();
+	Ainv.zeros();
+	for (int k = 0; k < 4; k++) {
+		A(k, k) = exp(complex<double>(0, theta[k]));
+		Ainv(k, k) = exp(complex<double>(0, -theta[k]));
+	};
+	K = Ub * P * Ainv;
+
+	split_local(B * K * B.t(), kak.a[0], kak.a[1]);
+	split_local(B * P.t() * B.t(), kak.b[0], kak.b[1]);
+
+	// theta_k = phase + c . h_k, h_k = diagonal of XX, YY, ZZ in the magic basis
+	cx_mat pauli[3] = { SX_matrix, SY_matrix, SZ_matrix };
+	for (int p = 0; p < 3; p++) {
+		cx_mat h = B.t() * kron(pauli[p], pauli[p]) * B;
+		kak.c[p] = 0;
+		for (int k = 0; k < 4; k++) kak.c[p] += theta[k] * real(h(k, k)) / 4;
+	};
+	return(kak);
+};
+
+// U as 3 CNOTs and 4 local layers; the interaction follows Vatan and Williams
+tTwoQubitCircuit two_qubit_circuit(cx_mat U) {
+	tKAK kak = kak_decompose(U);
+	tTwoQubitCircuit circ;
+	double half_pi = datum::pi / 2;
+
+	circ.local[0][0] = kak.b[0];
+	circ.local[0][1] = rz_matrix(-half_pi) * kak.b[1];
+	circ.local[1][0] = rz_matrix(half_pi - 2 * kak.c[2]);
+	circ.local[1][1] = ry_matrix(2 * kak.c[0] - half_pi);
+	circ.local[2][0] = I2.matrix;
+	circ.local[2][1] = ry_matrix(half_pi - 2 * kak.c[1]);
+	circ.local[3][0] = kak.a[0] * rz_matrix(half_pi);
+	circ.local[3][1] = kak.a[1];
+	circ.control[0] = 1;
+	circ.control[1] = 0;
+	circ.control[2] = 1;
+	circ.error = 0;
+	return(circ);
+};
+
+// Product of 4 local layers around 3 CNOTs, layer 0 first
+cx_mat circuit_matrix(const cx_mat local[4][2], const int control[3]) {
+	cx_mat m = eye<cx_mat>(4, 4);
+
+	for (int layer = 0; layer < 4; layer++) {
+		m = kron(local[layer][0], local[layer][1]) * m;
+		if (layer < 3) m = cnot_matrix(control[layer]) * m;
+	};
+	return(m);
+};
+
+class TwoQubitCompiler {
+public:
+	ApproxLookup *base;
+	BasicApproxSettings *settings;
+	int depth;               // SK depth of the single qubit factors
+	int n_threads;
+	size_t n_factors;        // factors of the last batch
+	size_t n_distinct;       // of which distinct unitaries
+
+	TwoQubitCompiler(ApproxLookup &b, BasicApproxSettings &sett, int n, int threads) {
+		base = &b;
+		settings = &sett;
+		depth = n;
+		n_threads = std::max(1, threads);
+		n_factors = 0;
+		n_distinct = 0;
+	};
+
+	// One SK run per distinct factor, spread over the threads
+	std::vector<tOper> approximate_all(std::vector<cx_mat> &factors) {
+		std::vector<tOper> out(factors.size());
+		std::vector<std::thread> threads;
+		std::atomic<size_t> next(0);
+
+		for (int t = 0; t < n_threads; t++) {
+			threads.push_back(std::thread([&]() {
+				SKApprox sk(*base, *settings);
+				for (size_t i = next++; i < factors.size(); i = next++) out[i] = sk.solovay_kitaev(factors[i], depth);
+			}));
+		};
+		for (auto &t : threads) t.join();
+		return(out);
+	};
+
+	std::vector<tTwoQubitCircuit> compile(std::vector<cx_mat> &targets) {
+		std::vector<tTwoQubitCircuit> circuits;
+		std::map<tQuatKey, size_t> index;
+		std::vector<cx_mat> distinct;
+		std::vector<size_t> slot;
+
+		for (auto &U : targets) {
+			circuits.push_back(two_qubit_circuit(U));
+			for (int layer = 0; layer < 4; layer++) {
+				for (int q = 0; q < 2; q++) {
+					tQuatKey key = utils::quaternion_key(circuits.back().local[layer][q]);
+					std::map<tQuatKey, size_t>::iterator it = index.find(key);
+					if (it == index.end()) {
+						it = index.insert(make_pair(key, distinct.size())).first;
+						distinct.push_back(circuits.back().local[layer][q]);
+					};
+					slot.push_back(it->second);
+				};
+			};
+		};
+		n_factors = slot.size();
+		n_distinct = distinct.size();
+
+		std::vector<tOper> approx = approximate_all(distinct);
+		for (size_t t = 0; t < circuits.size(); t++) {
+			tTwoQubitCircuit &circ = circuits[t];
+			cx_mat f[4][2];
+			for (int layer = 0; layer < 4; layer++) {
+				for (int q = 0; q < 2; q++) {
+					tOper &op = approx[slot[8 * t + 2 * layer + q]];
+					circ.sequence[layer][q] = op.ancestors;
+					f[layer][q] = op.matrix;
+				};
+			};
+			cx_mat m = circuit_matrix(f, circ.control);
+			circ.matrix = m;
+			circ.error = utils::fowler_distance(m, targets[t]);
+		};
+#ifdef _DEBUG
+		cout << "TwoQubitCompiler: " + to_string(targets.size()) + " targets, " + to_string(n_factors) + " factors, "
+			+ to_string(n_distinct) + " distinct" << endl;
+#endif
+		return(circuits);
+	};
+};
+
+#endif // kak_h__
@@ -0,0 +1,241 @@
+// Shared library with the C interface of libskt.h
+//
+//   make libskt             (see Makefile)
+//
+// Only the skt_* functions are exported. No exception crosses the
+// interface: the body of each one is in a try, and what it catches is
+// turned into a status (or NULL) and a per thread message.
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <armadillo>
+#include <sys/stat.h>
+#include "config.hpp"
+#include "libskt.h"
+
+struct skt_table {
+	BasicApproxSettings settings;
+	std::unique_ptr<ShardedTable> sharded;
+	std::unique_ptr<CurveTable> memory;
+	ApproxLookup *lookup;
+	std::map<std::string, uint8_t> gate_id;
+	int n_threads;
+
+	// Answers of the last call that found the gate buffer too small, handed
+	// out without recomputing when the same batch comes again. The batch
+	// is known by its size, depth and the hash of its targets, so no call
+	// copies them.
+	std::mutex pending_lock;
+	size_t pending_n;
+	uint64_t pending_hash;
+	int pending_depth;
+	std::vector<std::vector<uint8_t> > pending_seqs;
+	std::vector<double> pending_errors;
+};
+
+static thread_local std::string skt_error;
+
+// Status of the exception being handled, its message kept for skt_last_error
+static int skt_failure() {
+	try {
+		throw;
+	}
+	catch (std::bad_alloc &) {
+		skt_error = "Out of memory";
+	}
+	catch (exception &e) {
+		skt_error = e.what();
+	}
+	catch (...) {
+		skt_error = "Unknown exception";
+	};
+	return(SKT_LIB_ERROR);
+};
+
+static void skt_setup(skt_table *t) {
+	init_default_settings(t->settings);
+	for (size_t i = 0; i < t->settings.iset.size(); i++) t->gate_id[t->settings.iset[i].name] = (uint8_t)i;
+};
+
+// SK on every target, spread over the table's threads. Over the in memory
+// table each thread looks up through its own LookupSession, warm started
+// from its previous base cases.
+static bool skt_compute(skt_table *table, const double *targets, size_t n, int depth,
+	std::vector<std::vector<uint8_t> > &seqs, std::vector<double> &errs) {
+	std::vector<std::thread> threads;
+	std::atomic<size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::string failure;
+	std::mutex failure_lock;
+	int n_threads = (int)std::min((size_t)table->n_threads, std::max((size_t)1, n));
+
+	seqs.assign(n, std::vector<uint8_t>());
+	errs.assign(n, 0);
+	auto job = [&]() {
+		try {
+			std::unique_ptr<LookupSession> session;
+			if (table->memory) session.reset(new LookupSession(*table->memory));
+			SKApprox sk(session ? *session : *table->lookup, table->settings);
+			for (size_t i = next++; (i < n) && !failed; i = next++) {
+				const double *m = targets + 8 * i;
+				cx_mat target(2, 2);
+				for (int j = 0; j < 4; j++) target(j / 2, j % 2) = complex<double>(m[2 * j], m[2 * j + 1]);
+				tOper op = sk.solovay_kitaev(target, depth);
+				for (auto &g : table->settings.ancestors_to_array(op.ancestors)) seqs[i].push_back(table->gate_id.at(g.name));
+				errs[i] = utils::fowler_distance(op.matrix, target);
+			};
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> guard(failure_lock);
+			skt_failure();
+			failure = skt_error;
+			failed = true;
+		};
+	};
+	// A thread that cannot be started stops the others before the error
+	// leaves: a joinable std::thread must not be destroyed
+	try {
+		for (int k = 0; k < n_threads; k++) threads.push_back(std::thread(job));
+	}
+	catch (...) {
+		failed = true;
+		for (auto &t : threads) t.join();
+		throw;
+	};
+	for (auto &t : threads) t.join();
+	if (failed) skt_error = failure;
+	return(!failed);
+};
+
+extern "C" {
+
+SKT_LIB_API int skt_abi_version(void) {
+	return(SKT_LIB_ABI_VERSION);
+};
+
+SKT_LIB_API const char *skt_last_error(void) {
+	try {
+		return(skt_error.c_str());
+	}
+	catch (...) {
+		return("");
+	};
+};
+
+SKT_LIB_API skt_table *skt_open(const char *dir, int l0, int n_threads) {
+	static std::once_flag constants;
+
+	try {
+		std::call_once(constants, initOperConstants);
+		std::unique_ptr<skt_table> t(new skt_table());
+		skt_setup(t.get());
+		t->n_threads = (n_threads > 0) ? n_threads : (int)std::max(1u, std::thread::hardware_concurrency());
+		t->pending_n = 0;
+		t->pending_hash = 0;
+		t->pending_depth = -1;
+
+		if (dir == NULL) {
+			PrefixTable pt(t->settings);
+			pt.generate(l0);
+			tArrayOp table = pt.to_array();
+			t->memory.reset(new CurveTable(CURVE_HILBERT, 256));
+			t->memory->build(table);
+			t->lookup = t->memory.get();
+		}
+		else {
+			std::string table_dir = dir;
+			struct stat st;
+			if (stat((table_dir + "/index.skt").c_str(), &st) != 0) {
+				if (l0 <= 0) throw runtime_error("No table in " + table_dir);
+				mkdir(table_dir.c_str(), 0755);
+				ShardWriter writer(table_dir, 2);
+				basic_approxes_sharded(l0, t->settings, writer);
+			};
+			t->sharded.reset(new ShardedTable(table_dir, 0.05));
+			t->lookup = t->sharded.get();
+		};
+		return(t.release());
+	}
+	catch (...) {
+		skt_failure();
+		return(NULL);
+	};
+};
+
+SKT_LIB_API void skt_close(skt_table *table) {
+	try {
+		delete table;
+	}
+	catch (...) {
+		skt_failure();
+	};
+};
+
+SKT_LIB_API int skt_gate_count(const skt_table *table) {
+	try {
+		if (table == NULL) throw runtime_error("No table");
+		return((int)table->settings.iset.size());
+	}
+	catch (...) {
+		return(skt_failure());
+	};
+};
+
+SKT_LIB_API const char *skt_gate_name(const skt_table *table, int id) {
+	try {
+		if ((table == NULL) || (id < 0) || (id >= (int)table->settings.iset.size())) return(NULL);
+		return(table->settings.iset[id].name.c_str());
+	}
+	catch (...) {
+		skt_failure();
+		return(NULL);
+	};
+};
+
+SKT_LIB_API int skt_approximate(skt_table *table, const double *targets, size_t n, int depth,
+	uint8_t *gates, size_t capacity, size_t *offsets, double *errors) {
+	try {
+		std::vector<std::vector<uint8_t> > seqs;
+		std::vector<double> errs;
+		uint64_t hash = 0;
+
+		if ((table == NULL) || (offsets == NULL) || ((n > 0) && (targets == NULL))) throw runtime_error("NULL argument");
+		{
+			std::lock_guard<std::mutex> guard(table->pending_lock);
+			if ((table->pending_n == n) && (table->pending_depth == depth) && !table->pending_seqs.empty()) {
+				hash = fnv1a(targets, 8 * n * sizeof(double));
+				if (table->pending_hash == hash) {
+					seqs.swap(table->pending_seqs);
+					errs.swap(table->pending_errors);
+					table->pending_n = 0;
+				};
+			};
+		}
+		if ((seqs.size() != n) && !skt_compute(table, targets, n, depth, seqs, errs)) return(SKT_LIB_ERROR);
+
+		offsets[0] = 0;
+		for (size_t i = 0; i < n; i++) offsets[i + 1] = offsets[i] + seqs[i].size();
+		if (offsets[n] > capacity) {
+			skt_error = "Gate buffer of " + to_string(capacity) + " for " + to_string(offsets[n]) + " gates";
+			if (hash == 0) hash = fnv1a(targets, 8 * n * sizeof(double));
+			std::lock_guard<std::mutex> guard(table->pending_lock);
+			table->pending_n = n;
+			table->pending_hash = hash;
+			table->pending_depth = depth;
+			table->pending_seqs.swap(seqs);
+			table->pending_errors.swap(errs);
+			return(SKT_LIB_SHORT_BUFFER);
+		};
+		if ((offsets[n] > 0) && (gates == NULL)) throw runtime_error("NULL gate buffer");
+		for (size_t i = 0; i < n; i++) std::copy(seqs[i].begin(), seqs[i].end(), gates + offsets[i]);
+		if (errors != NULL) std::copy(errs.begin(), errs.end(), errors);
+		return(SKT_LIB_OK);
+	}
+	catch (...) {
+		return(skt_failure());
+	};
+};
+}
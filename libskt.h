@@ -0,0 +1,67 @@
+/* C interface of the approximation library (libskt.so, see libskt.cpp)
+ *
+ * A table is opened once and shared by every call (and thread). A batch of
+ * n targets is n 2x2 matrices, each 8 doubles row major as (re,im) pairs,
+ * as in the daemon protocol. The answers are packed in caller buffers:
+ * sequence i is gates[offsets[i] .. offsets[i+1]), one uint8 gate id per
+ * gate, and its matrix is the product gate(g[0]) gate(g[1]) ... in that
+ * order (the last gate acts first). Nothing is allocated for the caller.
+ *
+ * Functions return SKT_LIB_OK or a negative status; skt_last_error() then
+ * describes the failure of the calling thread. The layout of the buffers
+ * and the signatures below only change with SKT_LIB_ABI_VERSION.
+ */
+
+#ifndef libskt_h__
+#define libskt_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SKT_LIB_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define SKT_LIB_API __attribute__((visibility("default")))
+#else
+#define SKT_LIB_API
+#endif
+
+enum {
+	SKT_LIB_OK = 0,
+	SKT_LIB_ERROR = -1,          /* see skt_last_error() */
+	SKT_LIB_SHORT_BUFFER = -2    /* gates too small, offsets[n] is the size needed */
+};
+
+typedef struct skt_table skt_table;
+
+SKT_LIB_API int skt_abi_version(void);
+SKT_LIB_API const char *skt_last_error(void);
+
+/* dir with a sharded table (index.skt): mapped, nothing loaded but the index.
+ * dir without one: the table of length l0 is generated there first.
+ * dir NULL: the table of length l0 is generated in memory.
+ * n_threads: threads of skt_approximate, 0 for one per core. */
+SKT_LIB_API skt_table *skt_open(const char *dir, int l0, int n_threads);
+SKT_LIB_API void skt_close(skt_table *table);
+
+/* Gate ids are 0 .. skt_gate_count() - 1 */
+SKT_LIB_API int skt_gate_count(const skt_table *table);
+SKT_LIB_API const char *skt_gate_name(const skt_table *table, int id);
+
+/* targets: 8 n doubles; offsets: n + 1 entries; errors: n entries
+ * (fowler distance to the target) or NULL. depth is the SK depth, 0 for the
+ * table hit alone. On SKT_LIB_SHORT_BUFFER the answers are kept by the table:
+ * the same call again (same targets and depth) with a buffer of offsets[n]
+ * gates returns them without recomputing. */
+SKT_LIB_API int skt_approximate(skt_table *table, const double *targets, size_t n, int depth,
+	uint8_t *gates, size_t capacity, size_t *offsets, double *errors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* libskt_h__ */
@@ -4,6 +4,8 @@
 
 #include <iostream>
 #include <map>
+#include <string>
+#include <vector>
 #include <armadillo>
 
 
@@ -32,6 +34,16 @@ public:
 };
 
 typedef Oper tOper;
+typedef std::vector<tOper> tArrayOp;
+
+namespace utils {
+	string list_as_string(tArrayOp t1) {
+		string ll;
+		if (t1.size() == 0) return("");
+		for (auto ii : t1) ll += ii.name;
+		return(ll);
+	};
+};
 
 tOper T, I2, H, SZ, SY, SX, T_inv;
 cx_mat H_matrix(2, 2), SX_matrix(2, 2), SY_matrix(2, 2), SZ_matrix(2, 2);
@@ -65,21 +77,18 @@ Oper Oper::add_ancestor(Oper other, string new_name) {
 	return(new_op);
 };
 
-void Oper::matrix_from_ancestors(Oper isect_dict[], Oper identity, float tolerance) {
-	double dist;
-	
+void Oper::matrix_from_ancestors(Oper isect_dict[], Oper identity, float) {
 	for ( string::iterator it=ancestors.begin(); it!=ancestors.end(); ++it) {
-		matrix = matrix * isect_dict[*it].matrix;
+		matrix = matrix * isect_dict[(unsigned char)*it].matrix;
 	};
 	matrix = identity.matrix;
-	dist = utils::fowler_distance(matrix,identity.matrix);
 };
 
 bool Oper::operator==(const Oper &b) {
 	return ( (name == b.name) && (ancestors == b.ancestors) );
 };
 
-Oper Oper::multiply(Oper other, string new_name) {
+Oper Oper::multiply(Oper other, string) {
 	cx_mat new_matrix = matrix * other.matrix;
 	string new_ancestors = ancestors + other.ancestors;
 	Oper new_op ("",new_matrix,new_ancestors);
@@ -0,0 +1,127 @@
+// Counting global allocator for -DSKT_PERF builds of the programs
+//
+// Replaces the whole set of global operator new / delete (plain, array,
+// nothrow, sized and aligned forms) with malloc / free counting the
+// allocations of each thread; perf_allocation_count() gives the count to
+// the regions of perfcount.hpp. It is linked into the executables only:
+// libskt.so must not replace the allocator of its host program, and there
+// perf_allocation_count stays an unresolved weak symbol (0 allocations).
+// Without SKT_PERF this file is empty.
+
+#ifdef SKT_PERF
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+thread_local uint64_t perf_allocations = 0;
+
+uint64_t perf_allocation_count() {
+	return(perf_allocations);
+};
+
+static void *perf_malloc(size_t n) {
+	perf_allocations++;
+	return(malloc(n ? n : 1));
+};
+
+static void *perf_malloc_aligned(size_t n, std::align_val_t al) {
+	void *p = NULL;
+	size_t align = std::max((size_t)al, sizeof(void *));
+
+	perf_allocations++;
+	if (posix_memalign(&p, align, n ? n : 1) != 0) return(NULL);
+	return(p);
+};
+
+void *operator new(size_t n) {
+	void *p = perf_malloc(n);
+	if (p == NULL) throw std::bad_alloc();
+	return(p);
+};
+
+void *operator new[](size_t n) {
+	void *p = perf_malloc(n);
+	if (p == NULL) throw std::bad_alloc();
+	return(p);
+};
+
+void *operator new(size_t n, const std::nothrow_t &) noexcept {
+	return(perf_malloc(n));
+};
+
+void *operator new[](size_t n, const std::nothrow_t &) noexcept {
+	return(perf_malloc(n));
+};
+
+void *operator new(size_t n, std::align_val_t al) {
+	void *p = perf_malloc_aligned(n, al);
+	if (p == NULL) throw std::bad_alloc();
+	return(p);
+};
+
+void *operator new[](size_t n, std::align_val_t al) {
+	void *p = perf_malloc_aligned(n, al);
+	if (p == NULL) throw std::bad_alloc();
+	return(p);
+};
+
+void *operator new(size_t n, std::align_val_t al, const std::nothrow_t &) noexcept {
+	return(perf_malloc_aligned(n, al));
+};
+
+void *operator new[](size_t n, std::align_val_t al, const std::nothrow_t &) noexcept {
+	return(perf_malloc_aligned(n, al));
+};
+
+// Every form of delete frees: malloc and posix_memalign memory alike
+void operator delete(void *p) noexcept {
+	free(p);
+};
+
+void operator delete[](void *p) noexcept {
+	free(p);
+};
+
+void operator delete(void *p, size_t) noexcept {
+	free(p);
+};
+
+void operator delete[](void *p, size_t) noexcept {
+	free(p);
+};
+
+void operator delete(void *p, const std::nothrow_t &) noexcept {
+	free(p);
+};
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+	free(p);
+};
+
+void operator delete(void *p, std::align_val_t) noexcept {
+	free(p);
+};
+
+void operator delete[](void *p, std::align_val_t) noexcept {
+	free(p);
+};
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+	free(p);
+};
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+	free(p);
+};
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+	free(p);
+};
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept {
+	free(p);
+};
+
+#endif // SKT_PERF
@@ -0,0 +1,244 @@
+// Opt-in hardware counter instrumentation of the hot paths
+//
+// Compiled in only with -DSKT_PERF; otherwise the macros expand to nothing.
+// SKT_PERF_REGION(name) opens a scope reading, on entry and exit, the
+// thread's perf_event_open counters (cycles, instructions, LLC misses, dTLB
+// misses) and allocation count (perfalloc.cpp, see below), and adds
+// the difference to the totals of the region. Regions nest and their totals
+// are inclusive. SKT_PERF_COUNT(name) only counts calls, for kernels too
+// short to be worth two counter reads (the distances in utils.hpp). Those
+// counts are kept per thread and added to the totals when the thread leaves
+// a region (or ends), so the distance loops never touch a shared line.
+// perf_report() gives the totals; it is part of the server stats.
+//
+// Needs /proc/sys/kernel/perf_event_paranoid <= 2 (user space only is
+// counted); without it the counters read 0 and only calls, time and
+// allocations are reported.
+//
+// Allocations are counted by the global operator new of perfalloc.cpp,
+// which the Makefile links into the programs only; in libskt.so, or a
+// program built without it, they read 0.
+
+#ifndef perfcount_h__
+#define perfcount_h__
+
+#include <string>
+
+#ifdef SKT_PERF
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const int perf_n_counters = 4;
+const char *perf_counter_names[perf_n_counters] = { "cycles", "instructions", "LLC misses", "dTLB misses" };
+
+struct tPerfRegion {
+	std::string name;
+	size_t index;            // position in perf_regions
+	std::atomic<uint64_t> calls;
+	std::atomic<uint64_t> nanoseconds;
+	std::atomic<uint64_t> allocations;
+	std::atomic<uint64_t> counters[perf_n_counters];
+};
+
+std::mutex perf_regions_lock;
+std::deque<tPerfRegion> perf_regions;   // deque: stable addresses for the static slots
+// Defined by perfalloc.cpp when it is linked in
+uint64_t perf_allocation_count() __attribute__((weak));
+
+uint64_t perf_allocations() {
+	return(perf_allocation_count ? perf_allocation_count() : 0);
+};
+
+tPerfRegion *perf_region(std::string name) {
+	std::lock_guard<std::mutex> guard(perf_regions_lock);
+
+	for (auto &r : perf_regions) if (r.name == name) return(&r);
+	perf_regions.emplace_back();
+	tPerfRegion &r = perf_regions.back();
+	r.name = name;
+	r.index = perf_regions.size() - 1;
+	r.calls = 0;
+	r.nanoseconds = 0;
+	r.allocations = 0;
+	for (auto &c : r.counters) c = 0;
+	return(&r);
+};
+
+// SKT_PERF_COUNT calls of this thread not yet added to the regions
+struct tPerfPending {
+	std::vector<tPerfRegion *> regions;    // by region index
+	std::vector<uint64_t> calls;
+
+	~tPerfPending() {
+		fold();
+	};
+
+	void count(tPerfRegion *r) {
+		if (r->index >= calls.size()) {
+			regions.resize(r->index + 1, NULL);
+			calls.resize(r->index + 1, 0);
+		};
+		regions[r->index] = r;
+		calls[r->index]++;
+	};
+
+	void fold() {
+		for (size_t i = 0; i < calls.size(); i++) {
+			if (calls[i] == 0) continue;
+			regions[i]->calls.fetch_add(calls[i], std::memory_order_relaxed);
+			calls[i] = 0;
+		};
+	};
+};
+
+thread_local tPerfPending perf_pending;
+
+////////////////////////////////////////////////////////////////////
+// One counter group per thread, opened on first use
+struct tPerfCounters {
+	int leader;
+	int fd[perf_n_counters];
+	int slot[perf_n_counters];   // position in the group read, -1 if not available
+	int n_open;
+	bool tried;
+
+	tPerfCounters() {
+		leader = -1;
+		n_open = 0;
+		tried = false;
+		for (int i = 0; i < perf_n_counters; i++) {
+			fd[i] = -1;
+			slot[i] = -1;
+		};
+	};
+
+	~tPerfCounters() {
+		for (int i = 0; i < perf_n_counters; i++) if (fd[i] >= 0) ::close(fd[i]);
+	};
+
+	static int open_counter(uint32_t type, uint64_t config, int group) {
+		perf_event_attr attr;
+
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.disabled = (group < 0);
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		return((int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+	};
+
+	void open() {
+		uint32_t types[perf_n_counters] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE };
+		uint64_t configs[perf_n_counters] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+
+		tried = true;
+		for (int i = 0; i < perf_n_counters; i++) {
+			fd[i] = open_counter(types[i], configs[i], leader);
+			if (fd[i] < 0) continue;
+			if (leader < 0) leader = fd[i];
+			slot[i] = n_open++;
+		};
+		if (leader >= 0) {
+			ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		};
+	};
+
+	void read_values(uint64_t *values) {
+		uint64_t buf[1 + perf_n_counters];
+
+		if (!tried) open();
+		for (int i = 0; i < perf_n_counters; i++) values[i] = 0;
+		if ((leader < 0) || (::read(leader, buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t))) return;
+		for (int i = 0; i < perf_n_counters; i++) {
+			if ((slot[i] >= 0) && ((uint64_t)slot[i] < buf[0])) values[i] = buf[1 + slot[i]];
+		};
+	};
+};
+
+thread_local tPerfCounters perf_counters;
+
+class PerfScope {
+public:
+	tPerfRegion *region;
+	uint64_t start_values[perf_n_counters];
+	uint64_t start_allocations;
+	std::chrono::steady_clock::time_point start;
+
+	PerfScope(tPerfRegion *r) {
+		region = r;
+		start_allocations = perf_allocations();
+		perf_counters.read_values(start_values);
+		start = std::chrono::steady_clock::now();
+	};
+
+	~PerfScope() {
+		uint64_t values[perf_n_counters];
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		perf_counters.read_values(values);
+		perf_pending.fold();
+		region->calls++;
+		region->nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		region->allocations += perf_allocations() - start_allocations;
+		for (int i = 0; i < perf_n_counters; i++) region->counters[i] += values[i] - start_values[i];
+	};
+};
+
+#define SKT_PERF_JOIN2(a, b) a##b
+#define SKT_PERF_JOIN(a, b) SKT_PERF_JOIN2(a, b)
+#define SKT_PERF_REGION(name) \
+	static tPerfRegion *SKT_PERF_JOIN(skt_perf_slot_, __LINE__) = perf_region(name); \
+	PerfScope SKT_PERF_JOIN(skt_perf_scope_, __LINE__)(SKT_PERF_JOIN(skt_perf_slot_, __LINE__))
+#define SKT_PERF_COUNT(name) \
+	static tPerfRegion *SKT_PERF_JOIN(skt_perf_slot_, __LINE__) = perf_region(name); \
+	perf_pending.count(SKT_PERF_JOIN(skt_perf_slot_, __LINE__))
+
+std::string perf_report() {
+	std::string out;
+
+	perf_pending.fold();
+	std::lock_guard<std::mutex> guard(perf_regions_lock);
+
+	for (auto &r : perf_regions) {
+		out += "perf " + r.name + ": " + std::to_string(r.calls.load()) + " calls";
+		if (r.nanoseconds > 0) {
+			out += ", " + std::to_string(r.nanoseconds.load() / 1000) + " usec, " + std::to_string(r.allocations.load()) + " allocations";
+			for (int i = 0; i < perf_n_counters; i++) out += ", " + std::to_string(r.counters[i].load()) + " " + perf_counter_names[i];
+			if (r.counters[0] > 0) out += ", IPC " + std::to_string((double)r.counters[1] / r.counters[0]);
+		};
+		out += "\n";
+	};
+	return(out);
+};
+
+#else
+
+#define SKT_PERF_REGION(name)
+#define SKT_PERF_COUNT(name)
+
+std::string perf_report() {
+	return("");
+};
+
+#endif // SKT_PERF
+
+#endif // perfcount_h__
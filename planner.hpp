@@ -0,0 +1,337 @@
+// Cost-model planner choosing l0, SK depth and table variant from epsilon
+//
+// Small tables are generated one generation at a time and measured on
+// random targets: entries, coverage (worst nearest distance over the
+// sample, i.e. eps_0), length of the answers and lookup time. Larger l0
+// are extrapolated from the last measured growth ratio, with coverage
+// shrinking like N^(-1/3) (SU(2) is 3 dimensional). SK error propagation
+// eps_n = c eps_{n-1}^{3/2} uses a constant c calibrated on the largest
+// measured table. The lookups made by SK(n) and the SK work per lookup are
+// counted on the same table, through a CountingLookup; SK(n) multiplies
+// lengths by 5^n. The sharded table is written to shard_dir and read back
+// through ShardedTable, then removed.
+
+#ifndef planner_h__
+#define planner_h__
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "config.hpp"
+
+struct tTableStats {
+	int l0;
+	double entries;          // sequences kept by the variant
+	double coverage;         // worst nearest distance over the samples
+	double answer_length;    // mean number of gates of a lookup answer
+	double lookup_seconds;   // mean time of one lookup
+	double entry_bytes;      // resident memory per entry (disk for "sharded")
+	double generation_seconds;
+	bool measured;
+};
+
+// Counts the lookups passed to the base table and the time spent in them
+class CountingLookup: public ApproxLookup {
+public:
+	ApproxLookup *base;
+	size_t count;
+	double seconds;
+
+	CountingLookup(ApproxLookup &b) {
+		base = &b;
+		count = 0;
+		seconds = 0;
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		tApproxHit hit = base->lookup(target);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		seconds += elapsed.count();
+		count++;
+		return(hit);
+	};
+};
+
+struct tPlan {
+	std::string variant;     // "linear", "clifford" or "sharded"
+	int l0;
+	int depth;
+	double error;
+	double length;
+	double memory;           // resident bytes
+	double disk;
+	double seconds;          // per target
+	double generation_seconds;
+	bool feasible;
+};
+
+class ApproxPlanner {
+public:
+	BasicApproxSettings *settings;
+	int max_measured_l0;     // largest table actually generated to measure
+	int n_samples;
+	double sk_constant;
+	double sk_lookup_seconds;        // SK work (group commutators, compositions) per lookup made
+	std::vector<double> sk_lookups;  // lookups made by SK of depth 0, 1, 2
+	std::string shard_dir;           // scratch directory of the sharded measurement
+	std::vector<tQuat> samples;
+	std::map<std::string, std::vector<tTableStats> > measured;
+
+	ApproxPlanner(BasicApproxSettings &sett, int max_l0, int n_s) {
+		settings = &sett;
+		max_measured_l0 = max_l0;
+		n_samples = n_s;
+		sk_constant = 4 * sqrt(2.0);     // Dawson-Nielsen bound, until calibrated
+		sk_lookup_seconds = 0;
+		sk_lookups = { 1, 3, 9 };        // 3^n, until calibrated
+		shard_dir = "planner_shards";
+	};
+
+	void draw_samples() {
+		std::mt19937 gen(12345);
+		std::normal_distribution<double> normal(0, 1);
+
+		samples.clear();
+		for (int i = 0; i < n_samples; i++) {
+			tQuat q;
+			double n = 0;
+			for (auto &x : q) {
+				x = normal(gen);
+				n += x*x;
+			};
+			for (auto &x : q) x /= sqrt(n);
+			samples.push_back(q);
+		};
+	};
+
+	// Worst and mean-length nearest neighbour over the samples, linear table
+	tTableStats measure_linear(int l0, tArrayOp &table, double gen_seconds) {
+		tTableStats st;
+		std::vector<tQuat> qs;
+		double length = 0;
+
+		for (auto &op : table) qs.push_back(utils::su2_quaternion(op.matrix));
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		st.coverage = 0;
+		for (auto &s : samples) {
+			double best = HUGE_VAL;
+			size_t best_i = 0;
+			for (size_t i = 0; i < qs.size(); i++) {
+				double d = utils::quaternion_distance(s, qs[i]);
+				if (d < best) {
+					best = d;
+					best_i = i;
+				};
+			};
+			st.coverage = std::max(st.coverage, best);
+			length += settings->ancestors_to_array(table[best_i].ancestors).size();
+		};
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		st.l0 = l0;
+		st.entries = (double)table.size();
+		st.answer_length = length / samples.size();
+		st.lookup_seconds = elapsed.count() / samples.size();
+		st.entry_bytes = sizeof(Oper) + 4 * sizeof(complex<double>) + l0;
+		st.generation_seconds = gen_seconds;
+		st.measured = true;
+		return(st);
+	};
+
+	tTableStats measure_clifford(int l0, CliffordTable &ct, double gen_seconds) {
+		tTableStats st = measure_lookup(l0, ct, (double)ct.entries.size(), gen_seconds);
+
+		st.entry_bytes = sizeof(tCliffordEntry) + l0 + 64;   // + orbit_index node
+		return(st);
+	};
+
+	tTableStats measure_lookup(int l0, ApproxLookup &table, double entries, double gen_seconds) {
+		tTableStats st;
+		double length = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		st.coverage = 0;
+		for (auto &s : samples) {
+			tApproxHit hit = table.lookup(utils::quaternion_matrix(s));
+			st.coverage = std::max(st.coverage, hit.first);
+			length += settings->ancestors_to_array(hit.second.ancestors).size();
+		};
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		st.l0 = l0;
+		st.entries = entries;
+		st.answer_length = length / samples.size();
+		st.lookup_seconds = elapsed.count() / samples.size();
+		st.generation_seconds = gen_seconds;
+		st.measured = true;
+		return(st);
+	};
+
+	// Shards of the table in shard_dir, looked up through the mapped files
+	tTableStats measure_sharded(int l0, tArrayOp &table, double gen_seconds) {
+		ShardWriter writer(shard_dir, 2);
+		tTableStats st;
+
+		mkdir(shard_dir.c_str(), 0755);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (auto &op : table) writer.add(op);
+		writer.finalize();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		{
+			ShardedTable sharded(shard_dir, 0.05);
+			st = measure_lookup(l0, sharded, (double)table.size(), gen_seconds + elapsed.count());
+		}
+		for (auto &ci : writer.info) remove(writer.shard_path(ci.first, ".skt").c_str());
+		remove((shard_dir + "/index.skt").c_str());
+		rmdir(shard_dir.c_str());
+		st.entry_bytes = sizeof(tShardRecord) + st.answer_length;   // on disk
+		return(st);
+	};
+
+	// Generates l0 = 1..max_measured_l0 once, measuring every level, then
+	// calibrates the SK constant on the largest Clifford table
+	void measure() {
+		tArrayOp table = settings->iset;
+		tArrayOp generation = settings->iset;
+		CliffordTable ct(*settings);
+		double gen_seconds = 0;
+
+		draw_samples();
+		measured.clear();
+		for (auto &op : generation) ct.add(op);
+		for (int l = 1; l <= max_measured_l0; l++) {
+			if (l > 1) {
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				generation = settings->gen_basic_approx_generation(*settings, generation);
+				for (auto &op : generation) ct.add(op);
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				gen_seconds += elapsed.count();
+				table.insert(table.end(), generation.begin(), generation.end());
+			};
+			measured["linear"].push_back(measure_linear(l, table, gen_seconds));
+			measured["clifford"].push_back(measure_clifford(l, ct, gen_seconds));
+			measured["sharded"].push_back(measure_sharded(l, table, gen_seconds));
+		};
+		calibrate(ct);
+	};
+
+	// c = worst eps_n / eps_{n-1}^{3/2} seen at depths 1 and 2. Each depth is
+	// a full SK run, so its lookups are the ones predict() charges.
+	void calibrate(ApproxLookup &table) {
+		CountingLookup counter(table);
+		SKApprox sk(counter, *settings);
+		std::vector<double> lookups(3, 0);
+		double c = 0;
+		double sk_seconds = 0;
+		size_t sk_count = 0;
+		size_t n = 0;
+
+		for (; n < samples.size() && n < 8; n++) {
+			cx_mat target = utils::quaternion_matrix(samples[n]);
+			double prev_err = 0;
+			for (int d = 0; d <= 2; d++) {
+				counter.count = 0;
+				counter.seconds = 0;
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				tOper cur = sk.solovay_kitaev(target, d);
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				lookups[d] += counter.count;
+				if (d > 0) {
+					sk_seconds += elapsed.count() - counter.seconds;
+					sk_count += counter.count;
+				};
+				double err = utils::fowler_distance(cur.matrix, target);
+				if ((d > 0) && (prev_err > 1e-12)) c = std::max(c, err / pow(prev_err, 1.5));
+				prev_err = err;
+			};
+		};
+		if (c > 0) sk_constant = c;
+		if (n > 0) for (int d = 0; d <= 2; d++) sk_lookups[d] = lookups[d] / n;
+		if (sk_count > 0) sk_lookup_seconds = sk_seconds / sk_count;
+	};
+
+	// Lookups of SK(depth): counted up to depth 2, then growing by the last ratio
+	double lookup_count(int depth) {
+		int last = (int)sk_lookups.size() - 1;
+
+		if (depth <= last) return(sk_lookups[depth]);
+		return(sk_lookups[last] * pow(sk_lookups[last] / sk_lookups[last - 1], depth - last));
+	};
+
+	// Measured, or extrapolated from the last two measured levels
+	tTableStats table_stats(std::string variant, int l0) {
+		std::vector<tTableStats> &m = measured[variant];
+		if (l0 <= (int)m.size()) return(m[l0 - 1]);
+
+		tTableStats last = m.back();
+		tTableStats st = last;
+		double ratio = (m.size() > 1) ? std::max(1.0, last.entries / m[m.size() - 2].entries) : 2.0;
+		double growth = pow(ratio, l0 - last.l0);
+		st.l0 = l0;
+		st.entries = last.entries * growth;
+		st.coverage = last.coverage * pow(growth, -1.0 / 3);
+		st.answer_length = last.answer_length + (l0 - last.l0);
+		st.lookup_seconds = last.lookup_seconds * growth;
+		st.generation_seconds = last.generation_seconds * growth;
+		st.entry_bytes = last.entry_bytes + (l0 - last.l0);
+		st.measured = false;
+		return(st);
+	};
+
+	tPlan predict(std::string variant, int l0, int depth) {
+		tTableStats st = table_stats(variant, l0);
+		tPlan p;
+		double lookups = lookup_count(depth);
+
+		p.variant = variant;
+		p.l0 = l0;
+		p.depth = depth;
+		p.error = st.coverage;
+		for (int n = 1; n <= depth; n++) p.error = sk_constant * pow(p.error, 1.5);
+		p.length = st.answer_length * pow(5.0, depth);
+		p.memory = st.entries * st.entry_bytes;
+		p.disk = 0;
+		if (variant == "sharded") {
+			p.memory = pow(2.0, 4) * sizeof(tShardInfo);     // index of a div = 2 grid
+			p.disk = st.entries * st.entry_bytes;
+		};
+		p.seconds = lookups * (st.lookup_seconds + sk_lookup_seconds);
+		p.generation_seconds = st.generation_seconds;
+		p.feasible = true;
+		return(p);
+	};
+
+	// Shortest predicted sequence reaching eps within the budgets
+	// (ties on length go to the faster plan)
+	tPlan plan(double eps, double memory_budget, double seconds_budget, int max_l0, int max_depth) {
+		tPlan best;
+		std::vector<std::string> variants = { "linear", "clifford", "sharded" };
+
+		best.feasible = false;
+		if (measured.empty()) measure();
+		for (auto &v : variants) {
+			for (int l0 = 1; l0 <= max_l0; l0++) {
+				for (int n = 0; n <= max_depth; n++) {
+					tPlan p = predict(v, l0, n);
+					if ((p.error > eps) || (p.memory > memory_budget) || (p.seconds > seconds_budget)) continue;
+					if (!best.feasible || (p.length < best.length) || ((p.length == best.length) && (p.seconds < best.seconds))) best = p;
+					break;      // deeper only gets longer
+				};
+			};
+		};
+		return(best);
+	};
+
+	void print_plan(tPlan &p) {
+		if (!p.feasible) {
+			cout << "No plan reaches the target within the budgets" << endl;
+			return;
+		};
+		cout << "PLAN: " + p.variant + " table, l0=" + to_string(p.l0) + ", depth n=" + to_string(p.depth) << endl;
+		cout << "  predicted error " + to_string(p.error) + ", length " + to_string((long)p.length) + " gates" << endl;
+		cout << "  memory " + to_string(p.memory / 1048576) + " MB, disk " + to_string(p.disk / 1048576) + " MB" << endl;
+		cout << "  " + to_string(p.seconds * 1e3) + " ms per target, table generation " + to_string(p.generation_seconds) + " s" << endl;
+		cout << "  (SK constant " + to_string(sk_constant) + ")" << endl;
+	};
+};
+
+#endif // planner_h__
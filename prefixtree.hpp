@@ -0,0 +1,147 @@
+// Table of basic approximations stored as a prefix tree
+//
+// Every sequence kept by generation extends a sequence of the previous
+// generation by one instruction, so a node only holds its parent, the last
+// instruction and its matrix, computed as parent * instruction with one 2x2
+// product. Sequences are rebuilt on demand by walking the parents.
+// The dimension D of the instructions is a template parameter (fixed.hpp):
+// PrefixTable is the qubit table, PrefixTableD<3> a qutrit one, ...
+
+#ifndef prefixtree_h__
+#define prefixtree_h__
+
+#include <vector>
+#include <string>
+#include <complex>
+#include <algorithm>
+#include "config.hpp"
+
+template<int D> struct tPrefixNode {
+	int32_t parent;          // -1 for the sequences of one instruction
+	int32_t gate;            // index in settings->iset
+	tFixedMat<D> m;          // matrix of the sequence
+};
+
+template<int D> class PrefixTableD: public ApproxLookup {
+public:
+	BasicApproxSettings *settings;
+	std::vector<tPrefixNode<D> > nodes;
+	std::vector<size_t> generation_start;   // first node of each generation
+	std::vector<tFixedMat<D> > gates;       // matrices of settings->iset
+
+	PrefixTableD(BasicApproxSettings &sett) {
+		settings = &sett;
+	};
+
+	size_t add(int32_t parent, int32_t gate) {
+		tPrefixNode<D> node;
+
+		node.parent = parent;
+		node.gate = gate;
+		if (parent < 0) node.m = gates[gate];
+		else fixed_multiply(nodes[parent].m, gates[gate], node.m);
+		nodes.push_back(node);
+		return(nodes.size() - 1);
+	};
+
+	size_t length(size_t i) {
+		size_t l = 1;
+		for (int32_t p = nodes[i].parent; p >= 0; p = nodes[p].parent) l++;
+		return(l);
+	};
+
+	// Last n instructions of sequence i (all of them if it is shorter)
+	tArrayOp tail(size_t i, size_t n) {
+		tArrayOp seq;
+		int32_t p = (int32_t)i;
+
+		for (; (p >= 0) && (seq.size() < n); p = nodes[p].parent) seq.push_back(settings->iset[nodes[p].gate]);
+		std::reverse(seq.begin(), seq.end());
+		return(seq);
+	};
+
+	std::string sequence(size_t i) {
+		std::vector<int32_t> gates;
+		std::string ancs;
+
+		for (int32_t p = (int32_t)i; p >= 0; p = nodes[p].parent) gates.push_back(nodes[p].gate);
+		for (auto it = gates.rbegin(); it != gates.rend(); ++it) ancs += settings->iset[*it].name;
+		return(ancs);
+	};
+
+	cx_mat matrix(size_t i) {
+		return(nodes[i].m.to_mat());
+	};
+
+	tOper oper(size_t i) {
+		std::string ancs = sequence(i);
+		return(Oper(ancs, matrix(i), ancs));
+	};
+
+	// Same test as BasicApproxSettings::simplify_new (rewrites()). The
+	// parent was kept, so a rewrite can only start in the last window of
+	// the engine: a tail of the longest rule is enough to decide it.
+	bool prune(size_t parent, int32_t gate) {
+		tArrayOp seq = tail(parent, settings->sse.max_arg_count);
+		seq.push_back(settings->iset[gate]);
+		return(settings->rewrites(seq));
+	};
+
+	void generate(int ll0) {
+		SKT_PERF_REGION("PrefixTable::generate");
+
+		nodes.clear();
+		gates.clear();
+		for (auto &op : settings->iset) gates.push_back(tFixedMat<D>::from(op.matrix));
+		generation_start.clear();
+		generation_start.push_back(0);
+		for (size_t g = 0; g < settings->iset.size(); g++) add(-1, (int32_t)g);
+		for (int l = 2; l <= ll0; l++) {
+			size_t begin = generation_start.back(), end = nodes.size();
+			generation_start.push_back(end);
+			for (size_t p = begin; p < end; p++) {
+				for (size_t g = 0; g < settings->iset.size(); g++) {
+					if (prune(p, (int32_t)g)) continue;
+					size_t i = add((int32_t)p, (int32_t)g);
+					if (settings->filter || settings->observer) {
+						tOper op = oper(i);
+						if (settings->filter && !settings->filter(op)) {
+							nodes.pop_back();
+							continue;
+						};
+						if (settings->observer) settings->observer(op);
+					};
+				};
+			};
+			cout << "Generation " + to_string(l) + ": " + to_string(nodes.size() - end) + " sequences" << endl;
+		};
+	};
+
+	// Plain array of sequences, as BasicApproxSettings::approxes
+	tArrayOp to_array() {
+		tArrayOp out;
+		for (size_t i = 0; i < nodes.size(); i++) out.push_back(oper(i));
+		return(out);
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		tFixedMat<D> t = tFixedMat<D>::from(target);
+		double best_dist = HUGE_VAL;
+		size_t best = 0;
+		SKT_PERF_REGION("PrefixTable::lookup");
+
+		if (nodes.empty()) return(make_pair(HUGE_VAL, Oper()));
+		for (size_t i = 0; i < nodes.size(); i++) {
+			double dist = fixed_fowler_distance(nodes[i].m, t);
+			if (dist < best_dist) {
+				best_dist = dist;
+				best = i;
+			};
+		};
+		return(make_pair(best_dist, oper(best)));
+	};
+};
+
+typedef PrefixTableD<2> PrefixTable;
+
+#endif // prefixtree_h__
@@ -0,0 +1,87 @@
+// Wire protocol shared by the approximation server and its clients
+//
+// Every message is a tWireHeader followed by len payload bytes (host byte
+// order, the socket is local). Payloads:
+//
+//   op                request                        response
+//   SKT_OP_APPROX     8 doubles, 2x2 target row      double distance + ancestors
+//                     major as (re,im) pairs
+//   SKT_OP_SIMPLIFY   ancestors string               uint32 removed + ancestors
+//   SKT_OP_STATS      (empty)                        text report
+//
+// On failure status is SKT_ERROR and the payload is the error message.
+
+#ifndef protocol_h__
+#define protocol_h__
+
+#include <cstdint>
+#include <cerrno>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+enum { SKT_OP_APPROX = 1, SKT_OP_SIMPLIFY = 2, SKT_OP_STATS = 3 };
+enum { SKT_OK = 0, SKT_ERROR = 1 };
+
+const uint32_t skt_max_payload = 1 << 24;
+
+struct tWireHeader {
+	uint8_t op;
+	uint8_t status;          // responses only
+	uint16_t reserved;
+	uint32_t id;             // chosen by the client, echoed in the response
+	uint32_t len;            // payload bytes following the header
+};
+
+struct tWireMessage {
+	tWireHeader hdr;
+	std::string payload;
+};
+
+bool write_all(int fd, const char *buf, size_t n) {
+	while (n > 0) {
+		ssize_t w = ::send(fd, buf, n, MSG_NOSIGNAL);
+		if (w < 0 && errno == EINTR) continue;
+		if (w <= 0) return(false);
+		buf += w;
+		n -= w;
+	};
+	return(true);
+};
+
+bool read_all(int fd, char *buf, size_t n) {
+	while (n > 0) {
+		ssize_t r = ::read(fd, buf, n);
+		if (r < 0 && errno == EINTR) continue;
+		if (r <= 0) return(false);
+		buf += r;
+		n -= r;
+	};
+	return(true);
+};
+
+bool write_message(int fd, tWireHeader hdr, const std::string &payload) {
+	hdr.len = (uint32_t)payload.size();
+	std::string frame((const char *)&hdr, sizeof(hdr));
+	frame += payload;
+	return(write_all(fd, frame.data(), frame.size()));
+};
+
+bool read_message(int fd, tWireMessage &msg) {
+	if (!read_all(fd, (char *)&msg.hdr, sizeof(msg.hdr))) return(false);
+	if (msg.hdr.len > skt_max_payload) return(false);
+	msg.payload.resize(msg.hdr.len);
+	if (msg.hdr.len == 0) return(true);
+	return(read_all(fd, &msg.payload[0], msg.hdr.len));
+};
+
+sockaddr_un unix_address(std::string path) {
+	sockaddr_un addr = {};
+
+	addr.sun_family = AF_UNIX;
+	path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+	return(addr);
+};
+
+#endif // protocol_h__
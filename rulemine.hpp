@@ -0,0 +1,238 @@
+// Automatic discovery of simplification rules from generated tables
+//
+// While a table is generated every kept sequence is keyed by its unitary
+// (canonical quaternion, so up to global phase). When two sequences share
+// a key the larger one in shortlex order (shorter first, then by gate
+// index) becomes a rewrite to the smaller one. Shortlex is a well order
+// compatible with concatenation, so the rule set always terminates.
+// complete() adds the rules needed to resolve critical pairs (overlaps of
+// two left hand sides) as in Knuth-Bendix, within max_rules.
+//
+// Rule files hold one "lhs -> rhs" per line as ancestors strings, with
+// "I" for an empty right hand side.
+
+#ifndef rulemine_h__
+#define rulemine_h__
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "config.hpp"
+
+typedef std::vector<int> tWord;          // gate indices in settings->iset
+typedef std::pair<tWord, tWord> tRewrite;
+
+bool shortlex_less(const tWord &a, const tWord &b) {
+	if (a.size() != b.size()) return(a.size() < b.size());
+	return(a < b);
+};
+
+class RuleMiner {
+public:
+	BasicApproxSettings *settings;
+	std::map<tQuatKey, tWord> shortest;
+	std::vector<tRewrite> rules;
+	ruleSet installed;       // mined rules in the engine, from the last install()
+	size_t max_rules;
+	size_t n_observed;
+
+	RuleMiner(BasicApproxSettings &sett, size_t max_r) {
+		settings = &sett;
+		max_rules = max_r;
+		n_observed = 0;
+	};
+
+	tWord to_word(std::string ancs) {
+		tArrayOp seq = settings->ancestors_to_array(ancs);
+		tWord w;
+
+		for (auto &op : seq) {
+			for (size_t i = 0; i < settings->iset.size(); i++) {
+				if (settings->iset[i].name == op.name) {
+					w.push_back((int)i);
+					break;
+				};
+			};
+		};
+		return(w);
+	};
+
+	tArrayOp to_array(const tWord &w) {
+		tArrayOp seq;
+		for (auto g : w) seq.push_back(settings->iset[g]);
+		return(seq);
+	};
+
+	// Hooks the miner into generation; the identity and the instructions
+	// are the first sequences seen. Pairs multiplying to the identity
+	// (H H, T Td) are pruned by the hand written rules before they can be
+	// observed, so they are seeded here: completion must know them too.
+	void attach() {
+		tQuatKey id_key = utils::quaternion_key(eye<cx_mat>(2, 2));
+
+		shortest[id_key] = tWord();
+		for (auto &op : settings->iset) observe(op);
+		for (int i = 0; i < (int)settings->iset.size(); i++)
+			for (int j = 0; j < (int)settings->iset.size(); j++)
+				if (utils::quaternion_key(settings->iset[i].matrix * settings->iset[j].matrix) == id_key) add_rule({ i, j }, tWord());
+		settings->observer = [this](tOper &op) { observe(op); };
+	};
+
+	void detach() {
+		settings->observer = nullptr;
+	};
+
+	void observe(tOper &op) {
+		tQuatKey key = utils::quaternion_key(op.matrix);
+		tWord w = to_word(op.ancestors);
+
+		n_observed++;
+		if (shortest.count(key) == 0) {
+			shortest[key] = w;
+			return;
+		};
+		tWord &known = shortest[key];
+		if (known == w) return;
+		if (shortlex_less(w, known)) {
+			add_rule(known, w);
+			known = w;
+		}
+		else add_rule(w, known);
+	};
+
+	// Position of the first occurrence of lhs in w, or -1
+	static int find(const tWord &w, const tWord &lhs) {
+		if (lhs.empty() || (lhs.size() > w.size())) return(-1);
+		for (size_t i = 0; i + lhs.size() <= w.size(); i++) {
+			if (std::equal(lhs.begin(), lhs.end(), w.begin() + i)) return((int)i);
+		};
+		return(-1);
+	};
+
+	tWord normalize(tWord w) {
+		bool changed = true;
+
+		while (changed) {
+			changed = false;
+			for (auto &r : rules) {
+				int pos = find(w, r.first);
+				if (pos < 0) continue;
+				w.erase(w.begin() + pos, w.begin() + pos + r.first.size());
+				w.insert(w.begin() + pos, r.second.begin(), r.second.end());
+				changed = true;
+			};
+		};
+		return(w);
+	};
+
+	// Orients the pair, drops it when the rules already join both sides,
+	// and removes the rules whose left hand side it makes redundant
+	bool add_rule(tWord a, tWord b) {
+		a = normalize(a);
+		b = normalize(b);
+		if (a == b) return(false);
+		if (rules.size() >= max_rules) return(false);
+		if (shortlex_less(a, b)) std::swap(a, b);
+
+		rules.erase(std::remove_if(rules.begin(), rules.end(),
+			[&a](tRewrite &r) { return(find(r.first, a) >= 0); }), rules.end());
+		rules.push_back(make_pair(a, b));
+#ifdef _DEBUG
+		cout << "RuleMiner: " + utils::list_as_string(to_array(a)) + " -> " + utils::list_as_string(to_array(b)) << endl;
+#endif
+		return(true);
+	};
+
+	// Resolves the critical pairs: for l1 = x y and l2 = y z, the word
+	// x y z rewrites to r1 z and to x r2, which must have one normal form
+	void complete() {
+		bool added = true;
+
+		while (added && (rules.size() < max_rules)) {
+			added = false;
+			std::vector<tRewrite> current = rules;
+			for (size_t i = 0; i < current.size(); i++) {
+				for (size_t j = 0; j < current.size(); j++) {
+					tWord &l1 = current[i].first;
+					tWord &l2 = current[j].first;
+					for (size_t k = 1; k < l1.size() && k < l2.size(); k++) {
+						if (!std::equal(l1.end() - k, l1.end(), l2.begin())) continue;
+						tWord left = current[i].second;
+						left.insert(left.end(), l2.begin() + k, l2.end());
+						tWord right(l1.begin(), l1.end() - k);
+						right.insert(right.end(), current[j].second.begin(), current[j].second.end());
+						if (add_rule(left, right)) added = true;
+					};
+				};
+			};
+		};
+	};
+
+	ruleSet make_rules() {
+		ruleSet rs;
+		ProductFactory pRule;
+
+		for (auto &r : rules) rs.push_back(pRule.Make(4, to_array(r.first), to_array(r.second)));
+		return(rs);
+	};
+
+	// Rebuilds the engine from the hand written rules plus the current mined
+	// ones, so the next generations prune with them. The rules installed
+	// before are replaced, not added to.
+	void install(ruleSet base) {
+		ruleSet rs = base;
+		ruleSet previous = installed;
+
+		installed = make_rules();
+		rs.insert(rs.end(), installed.begin(), installed.end());
+		settings->init_simplify_engine(rs);
+		for (auto r : previous) delete r;
+	};
+
+	// Table generation with mining: after every generation the rules found
+	// so far are completed and installed, so the next one prunes with them
+	void mine(int ll0, ruleSet base) {
+		tArrayOp generation = settings->iset;
+
+		attach();
+		settings->approxes = generation;
+		for (int l = 2; l <= ll0; l++) {
+			generation = settings->gen_basic_approx_generation(*settings, generation);
+			settings->approxes.insert(settings->approxes.end(), generation.begin(), generation.end());
+			complete();
+			install(base);
+			cout << "Generation " + to_string(l) + ": " + to_string(generation.size()) + " sequences, "
+				+ to_string(rules.size()) + " mined rules" << endl;
+		};
+		detach();
+	};
+
+	void save(std::string filename) {
+		ofstream out(filename);
+
+		for (auto &r : rules) {
+			std::string rhs = utils::list_as_string(to_array(r.second));
+			out << utils::list_as_string(to_array(r.first)) << " -> " << (rhs.empty() ? "I" : rhs) << endl;
+		};
+		if (!out) throw runtime_error("Cannot write rules to " + filename);
+	};
+};
+
+// Rules saved by RuleMiner::save, ready to be added to a SimplifyEngine
+ruleSet load_rules(std::string filename, BasicApproxSettings &sett) {
+	ifstream in(filename);
+	std::string line, lhs, arrow, rhs;
+	ruleSet rs;
+	ProductFactory pRule;
+
+	if (!in) throw runtime_error("Cannot read rules from " + filename);
+	while (getline(in, line)) {
+		std::istringstream ls(line);
+		if (!(ls >> lhs >> arrow >> rhs) || (arrow != "->")) continue;
+		tArrayOp repl = (rhs == "I") ? tArrayOp() : sett.ancestors_to_array(rhs);
+		rs.push_back(pRule.Make(4, sett.ancestors_to_array(lhs), repl));
+	};
+	return(rs);
+};
+
+#endif // rulemine_h__
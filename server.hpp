@@ -0,0 +1,243 @@
+// Approximation server over a Unix domain socket
+//
+// Loads the table and the SimplifyEngine once and serves approximation and
+// simplification requests (see protocol.hpp); a sequence is simplified whole
+// (simplify_sequence in stream.hpp). Each connection has a reader
+// thread queueing its requests; a pool of workers serves the queue, so a
+// client may pipeline many requests and several clients run concurrently.
+// Answers carry the request id and can come back out of order.
+
+#ifndef server_h__
+#define server_h__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <poll.h>
+#include "protocol.hpp"
+#include "config.hpp"
+
+volatile sig_atomic_t skt_server_stop = 0;
+
+struct tConnection {
+	int fd;
+	std::mutex write_lock;
+
+	tConnection(int f) {
+		fd = f;
+	};
+
+	~tConnection() {
+		::close(fd);
+	};
+};
+
+struct tJob {
+	std::shared_ptr<tConnection> conn;
+	tWireMessage msg;
+	std::chrono::steady_clock::time_point received;
+};
+
+////////////////////////////////////////////////////////////////////
+// Latency of the last max_samples requests of each op, in microseconds
+// from the request being read to its answer being written.
+class LatencyStats {
+public:
+	std::mutex lock;
+	size_t max_samples;
+	std::map<int, std::vector<double> > samples;
+	std::map<int, size_t> total;
+
+	LatencyStats(size_t max_s) {
+		max_samples = max_s;
+	};
+
+	void add(int op, double usec) {
+		std::lock_guard<std::mutex> guard(lock);
+		std::vector<double> &s = samples[op];
+		if (s.size() < max_samples) s.push_back(usec);
+		else s[total[op] % max_samples] = usec;
+		total[op]++;
+	};
+
+	static double percentile(std::vector<double> s, double p) {
+		if (s.empty()) return(0);
+		size_t k = std::min(s.size() - 1, (size_t)(p * s.size()));
+		std::nth_element(s.begin(), s.begin() + k, s.end());
+		return(s[k]);
+	};
+
+	std::string report() {
+		std::lock_guard<std::mutex> guard(lock);
+		std::string out;
+		const char *names[] = { "", "approx", "simplify", "stats" };
+
+		for (auto &op : samples) {
+			std::string name = (op.first >= 1 && op.first <= 3) ? names[op.first] : to_string(op.first);
+			out += name + ": " + to_string(total[op.first]) + " requests, usec"
+				+ " p50=" + to_string(percentile(op.second, 0.50))
+				+ " p90=" + to_string(percentile(op.second, 0.90))
+				+ " p99=" + to_string(percentile(op.second, 0.99))
+				+ " p99.9=" + to_string(percentile(op.second, 0.999)) + "\n";
+		};
+		return(out);
+	};
+};
+
+class ApproxServer {
+public:
+	std::string socket_path;
+	ApproxLookup *table;
+	BasicApproxSettings *settings;
+	int n_workers;
+	int listen_fd;
+	LatencyStats stats;
+
+	std::mutex queue_lock;
+	std::condition_variable queue_ready;
+	std::deque<tJob> jobs;
+	std::vector<std::thread> workers;
+	std::atomic<int> active_readers;
+	std::vector<std::weak_ptr<tConnection> > connections;
+
+	ApproxServer(std::string path, ApproxLookup *tab, BasicApproxSettings *sett, int n_w) : stats(100000) {
+		socket_path = path;
+		table = tab;
+		settings = sett;
+		n_workers = n_w;
+		listen_fd = -1;
+		active_readers = 0;
+	};
+
+	void listen_socket() {
+		sockaddr_un addr = unix_address(socket_path);
+
+		unlink(socket_path.c_str());
+		listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0) throw runtime_error("Cannot create socket");
+		if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) < 0) throw runtime_error("Cannot bind " + socket_path);
+		if (listen(listen_fd, 64) < 0) throw runtime_error("Cannot listen on " + socket_path);
+	};
+
+	// Accepts connections until skt_server_stop is set (e.g. by a signal)
+	void run() {
+		listen_socket();
+		for (int i = 0; i < n_workers; i++) workers.push_back(std::thread(&ApproxServer::worker, this));
+		cout << "Serving on " + socket_path + " with " + to_string(n_workers) + " workers" << endl;
+
+		while (!skt_server_stop) {
+			pollfd pfd = { listen_fd, POLLIN, 0 };
+			if (poll(&pfd, 1, 200) <= 0) continue;
+			int fd = accept(listen_fd, NULL, NULL);
+			if (fd < 0) continue;
+			std::shared_ptr<tConnection> conn(new tConnection(fd));
+			connections.erase(std::remove_if(connections.begin(), connections.end(),
+				[](std::weak_ptr<tConnection> &c) { return(c.expired()); }), connections.end());
+			connections.push_back(conn);
+			active_readers++;
+			std::thread(&ApproxServer::reader, this, conn).detach();
+		};
+		shutdown_server();
+	};
+
+	void shutdown_server() {
+		::close(listen_fd);
+		unlink(socket_path.c_str());
+		for (auto &c : connections) {
+			std::shared_ptr<tConnection> conn = c.lock();
+			if (conn) ::shutdown(conn->fd, SHUT_RDWR);
+		};
+		while (active_readers > 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		queue_ready.notify_all();
+		for (auto &t : workers) t.join();
+		cout << stats.report() + perf_report();
+	};
+
+	void reader(std::shared_ptr<tConnection> conn) {
+		tJob job;
+
+		job.conn = conn;
+		while (read_message(conn->fd, job.msg)) {
+			job.received = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> guard(queue_lock);
+				jobs.push_back(job);
+			}
+			queue_ready.notify_one();
+		};
+		active_readers--;
+	};
+
+	void worker() {
+		while (true) {
+			tJob job;
+			{
+				std::unique_lock<std::mutex> guard(queue_lock);
+				queue_ready.wait(guard, [this] { return(!jobs.empty() || skt_server_stop); });
+				if (jobs.empty()) return;
+				job = jobs.front();
+				jobs.pop_front();
+			}
+			serve(job);
+		};
+	};
+
+	std::string answer(tWireMessage &msg) {
+		std::string body;
+
+		switch (msg.hdr.op) {
+		case SKT_OP_APPROX: {
+			double m[8];
+			cx_mat target(2, 2);
+			if (msg.payload.size() != sizeof(m)) throw domain_error("Approximation target must be 8 doubles");
+			memcpy(m, msg.payload.data(), sizeof(m));
+			for (int i = 0; i < 4; i++) target(i / 2, i % 2) = complex<double>(m[2 * i], m[2 * i + 1]);
+			tApproxHit hit = table->lookup(target);
+			body.assign((const char *)&hit.first, sizeof(double));
+			body += hit.second.ancestors;
+			return(body);
+		}
+		case SKT_OP_SIMPLIFY: {
+			tArrayOp seq = settings->ancestors_to_array(msg.payload);
+			tArrayOp simp = simplify_sequence(settings->sse, seq);
+			uint32_t removed = (uint32_t)(seq.size() - simp.size());
+			body.assign((const char *)&removed, sizeof(removed));
+			body += utils::list_as_string(simp);
+			return(body);
+		}
+		case SKT_OP_STATS:
+			return(stats.report() + perf_report());
+		default:
+			throw domain_error("Unknown op " + to_string(msg.hdr.op));
+		};
+	};
+
+	void serve(tJob &job) {
+		tWireHeader out = job.msg.hdr;
+		std::string body;
+
+		out.status = SKT_OK;
+		try {
+			body = answer(job.msg);
+		}
+		catch (exception &e) {
+			out.status = SKT_ERROR;
+			body = e.what();
+		};
+		{
+			std::lock_guard<std::mutex> guard(job.conn->write_lock);
+			write_message(job.conn->fd, out, body);
+		}
+		std::chrono::duration<double, std::micro> usec = std::chrono::steady_clock::now() - job.received;
+		stats.add(out.op, usec.count());
+	};
+};
+
+#endif // server_h__
@@ -0,0 +1,118 @@
+// Lookup session warm started from the previous queries
+//
+// Inside one SK run the base case targets are close to each other (deep
+// levels only look up small rotations), yet each lookup of the table starts
+// from scratch. A LookupSession keeps the neighbourhood of a full search:
+// every record within angle R of the query q0 that started it, with
+// theta(p, q) = arccos |q.p|, a metric on SU(2) up to phase. For a new query
+// q at angle delta from q0, a record outside the neighbourhood is at least
+// R - delta from q (triangle inequality). So if the best record of the
+// neighbourhood is within R - delta, it is the table's nearest entry.
+// Otherwise the table is searched with that record as the first bound
+// (CurveTable::search), and the neighbourhood moves to q when q is farther
+// than recenter R from q0.
+//
+// R is radius_factor times the angle of the nearest entry plus slack, and the
+// neighbourhood is cut down to its max_neighbours nearest records (R shrinks
+// to the first record left out).
+
+#ifndef session_h__
+#define session_h__
+
+#include <vector>
+#include <algorithm>
+#include "config.hpp"
+
+class LookupSession: public ApproxLookup {
+public:
+	CurveTable *table;
+	double radius_factor;
+	double slack;            // angle added to the radius
+	size_t max_neighbours;
+	double recenter;         // a miss farther than recenter R from q0 moves the neighbourhood
+	bool valid;              // a neighbourhood is held
+	tQuat center;            // q0
+	double radius;           // R
+	std::vector<size_t> neighbours;   // records within R of q0
+	size_t n_queries, n_warm;
+
+	LookupSession(CurveTable &t) {
+		table = &t;
+		radius_factor = 2;
+		slack = 0.15;
+		max_neighbours = 4096;
+		recenter = 1;
+		valid = false;
+		radius = 0;
+		n_queries = 0;
+		n_warm = 0;
+	};
+
+	static double angle(tQuat q, tQuat p) {
+		double dot = fabs(q[0] * p[0] + q[1] * p[1] + q[2] * p[2] + q[3] * p[3]);
+		return(acos(std::min(1.0, dot)));
+	};
+
+	// Fowler distance sqrt(1 - cos theta) and back
+	static double fowler(double theta) {
+		return(sqrt(std::max(0.0, 1 - cos(theta))));
+	};
+
+	static double from_fowler(double d) {
+		return(acos(std::max(-1.0, 1 - d * d)));
+	};
+
+	// The records within R of q, R set from the angle of its nearest entry
+	void refill(tQuat q, double nearest) {
+		std::vector<std::pair<size_t, double> > near;
+
+		radius = std::min(radius_factor * nearest + slack, datum::pi / 2);
+		table->within(q, fowler(radius), near);
+		if (near.size() > max_neighbours) {
+			std::nth_element(near.begin(), near.begin() + max_neighbours, near.end(),
+				[](const std::pair<size_t, double> &a, const std::pair<size_t, double> &b) { return(a.second < b.second); });
+			radius = from_fowler(near[max_neighbours].second);
+			near.resize(max_neighbours);
+		};
+		neighbours.clear();
+		for (auto &e : near) neighbours.push_back(e.first);
+		center = q;
+		valid = true;
+	};
+
+	void reset() {
+		valid = false;
+		neighbours.clear();
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		tQuat q = utils::su2_quaternion(target);
+		double best_dot = -1;
+		size_t best = 0;
+		SKT_PERF_REGION("LookupSession::lookup");
+
+		if (table->n_records == 0) return(make_pair(HUGE_VAL, Oper()));
+		n_queries++;
+		for (auto i : neighbours) {
+			const double *p = table->records[i].q;
+			double dot = fabs(q[0] * p[0] + q[1] * p[1] + q[2] * p[2] + q[3] * p[3]);
+			if (dot > best_dot) {
+				best_dot = dot;
+				best = i;
+			};
+		};
+		double delta = valid ? angle(q, center) : 0;
+		double best_dist = neighbours.empty() ? HUGE_VAL : sqrt(std::max(0.0, 1 - best_dot));
+		if (valid && !neighbours.empty() && (acos(std::min(1.0, best_dot)) <= radius - delta)) {
+			n_warm++;
+			return(table->record_hit(best, best_dist));
+		};
+
+		// Full search, pruned from the start by the neighbourhood's best
+		table->search(q, best_dist, best);
+		if (!valid || (delta > recenter * radius)) refill(q, from_fowler(best_dist));
+		return(table->record_hit(best, best_dist));
+	};
+};
+
+#endif // session_h__
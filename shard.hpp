@@ -0,0 +1,411 @@
+// Sharded on-disk table of basic approximations
+//
+// Tables for deep l0 (or big instruction sets) do not fit in memory, so the
+// entries are partitioned by region of SU(2): the canonical quaternion of
+// each entry (w >= 0 hemisphere) falls in one cell of a div^4 grid over
+// (w,x,y,z), with div = 2 giving hemisphere halves times (x,y,z) octants.
+// Each non empty cell is a shard file. Only the shard index (bounding box
+// of every shard) is kept in memory; a query mmaps the shards whose box
+// comes within epsilon of the target.
+//
+// Shard file (shard_<cell>.skt) : tShardHeader | tShardRecord[count] | ancestors bytes
+// Index file (index.skt)        : tIndexHeader | tShardInfo[n_shards]
+
+#ifndef shard_h__
+#define shard_h__
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "config.hpp"
+
+struct tShardHeader {
+	char magic[8];           // "SKTSHRD1"
+	uint64_t count;          // number of records
+	uint64_t seq_bytes;      // size of the ancestors blob after the records
+};
+
+struct tShardRecord {
+	double q[4];             // canonical quaternion (utils::su2_quaternion)
+	uint64_t seq_off;        // ancestors string, offset in the blob
+	uint32_t seq_len;
+	uint32_t reserved;
+};
+
+struct tShardInfo {
+	int32_t cell;
+	uint32_t reserved;
+	uint64_t count;
+	double lo[4], hi[4];     // bounding box of the quaternions in the shard
+};
+
+struct tIndexHeader {
+	char magic[8];           // "SKTINDX1"
+	uint32_t divisions;
+	uint32_t n_shards;
+};
+
+struct tShardMap {
+	void *base;
+	size_t bytes;
+};
+
+const char shard_magic[8] = { 'S', 'K', 'T', 'S', 'H', 'R', 'D', '1' };
+const char index_magic[8] = { 'S', 'K', 'T', 'I', 'N', 'D', 'X', '1' };
+
+// Grid cell of a canonical quaternion, w in [0,1] and x,y,z in [-1,1]
+int shard_cell(tQuat q, int div) {
+	int cell = std::min(div - 1, (int)floor(q[0] * div));
+	for (int i = 1; i < 4; i++) {
+		int c = std::min(div - 1, (int)floor((q[i] + 1) / 2 * div));
+		cell = cell * div + std::max(0, c);
+	};
+	return(std::max(0, cell));
+};
+
+// Squared euclidean distance from q to the box [lo,hi]
+double box_distance2(tQuat q, const double *lo, const double *hi) {
+	double d2 = 0;
+	for (int i = 0; i < 4; i++) {
+		if (q[i] < lo[i]) d2 += (lo[i] - q[i])*(lo[i] - q[i]);
+		else if (q[i] > hi[i]) d2 += (q[i] - hi[i])*(q[i] - hi[i]);
+	};
+	return(d2);
+};
+
+// Fowler distance <= eps means |q - p|^2 <= 2 eps^2 for q or -q,
+// so a shard can be skipped when its box is farther than that from both.
+bool shard_within(tShardInfo &info, tQuat q, double eps) {
+	tQuat mq = { -q[0], -q[1], -q[2], -q[3] };
+	double r2 = 2 * eps * eps;
+	return((box_distance2(q, info.lo, info.hi) <= r2) || (box_distance2(mq, info.lo, info.hi) <= r2));
+};
+
+////////////////////////////////////////////////////////////////////
+// Writes shards while the table is generated. Records are buffered per
+// cell and spilled to <cell>.rec / <cell>.seq temporary files, so the
+// memory used is bounded by buffer_limit records per cell.
+class ShardWriter {
+public:
+	std::string dir;
+	int divisions;
+	size_t buffer_limit;
+	std::map<int, std::vector<tShardRecord> > rec_buf;
+	std::map<int, std::string> seq_buf;
+	std::map<int, uint64_t> seq_bytes;
+	std::map<int, tShardInfo> info;
+	std::set<int> spilled;   // cells whose temporaries were started by this writer
+
+	ShardWriter(std::string d, int div, size_t limit) {
+		dir = d;
+		divisions = div;
+		buffer_limit = limit;
+	};
+
+	ShardWriter(std::string d, int div) : ShardWriter(d, div, 4096) {
+	};
+
+	std::string shard_path(int cell, std::string ext) {
+		return(dir + "/shard_" + to_string(cell) + ext);
+	};
+
+	void add(tOper &op) {
+		tShardRecord rec;
+		tQuat q = utils::su2_quaternion(op.matrix);
+		int cell = shard_cell(q, divisions);
+
+		if (info.count(cell) == 0) {
+			tShardInfo new_info;
+			new_info.cell = cell;
+			new_info.reserved = 0;
+			new_info.count = 0;
+			for (int i = 0; i < 4; i++) {
+				new_info.lo[i] = q[i];
+				new_info.hi[i] = q[i];
+			};
+			info[cell] = new_info;
+			seq_bytes[cell] = 0;
+		};
+		tShardInfo &ci = info[cell];
+		for (int i = 0; i < 4; i++) {
+			rec.q[i] = q[i];
+			ci.lo[i] = std::min(ci.lo[i], q[i]);
+			ci.hi[i] = std::max(ci.hi[i], q[i]);
+		};
+		rec.seq_off = seq_bytes[cell] + seq_buf[cell].size();
+		rec.seq_len = (uint32_t)op.ancestors.length();
+		rec.reserved = 0;
+		seq_buf[cell] += op.ancestors;
+		rec_buf[cell].push_back(rec);
+		ci.count++;
+
+		if (rec_buf[cell].size() >= buffer_limit) flush(cell);
+	};
+
+	void flush(int cell) {
+		std::vector<tShardRecord> &recs = rec_buf[cell];
+		std::string &seqs = seq_buf[cell];
+
+		if (recs.empty()) return;
+		// Leftovers of an earlier run are truncated on the first spill
+		ios::openmode mode = ios::binary | ((spilled.count(cell) == 0) ? ios::trunc : ios::app);
+		spilled.insert(cell);
+		ofstream rec_file(shard_path(cell, ".rec"), mode);
+		ofstream seq_file(shard_path(cell, ".seq"), mode);
+		if (!rec_file || !seq_file) throw runtime_error("Cannot write shard " + to_string(cell) + " in " + dir);
+		rec_file.write((const char *)recs.data(), recs.size() * sizeof(tShardRecord));
+		seq_file.write(seqs.data(), seqs.size());
+		seq_bytes[cell] += seqs.size();
+		recs.clear();
+		seqs.clear();
+	};
+
+	// Writes the final shard files and the index, removing the temporaries
+	void finalize() {
+		tIndexHeader ih;
+
+		for (auto &ci : info) {
+			int cell = ci.first;
+			tShardHeader sh;
+
+			flush(cell);
+			memcpy(sh.magic, shard_magic, 8);
+			sh.count = ci.second.count;
+			sh.seq_bytes = seq_bytes[cell];
+
+			ofstream out(shard_path(cell, ".skt"), ios::binary | ios::trunc);
+			out.write((const char *)&sh, sizeof(sh));
+			if (spilled.count(cell) > 0) {
+				ifstream rec_file(shard_path(cell, ".rec"), ios::binary);
+				out << rec_file.rdbuf();
+				ifstream seq_file(shard_path(cell, ".seq"), ios::binary);
+				if (sh.seq_bytes > 0) out << seq_file.rdbuf();
+			}
+			if (!out) throw runtime_error("Cannot write shard " + to_string(cell) + " in " + dir);
+			remove(shard_path(cell, ".rec").c_str());
+			remove(shard_path(cell, ".seq").c_str());
+		};
+		spilled.clear();
+
+		memcpy(ih.magic, index_magic, 8);
+		ih.divisions = divisions;
+		ih.n_shards = (uint32_t)info.size();
+		ofstream idx(dir + "/index.skt", ios::binary | ios::trunc);
+		idx.write((const char *)&ih, sizeof(ih));
+		for (auto &ci : info) idx.write((const char *)&ci.second, sizeof(tShardInfo));
+		if (!idx) throw runtime_error("Cannot write index in " + dir);
+
+#ifdef _DEBUG
+		cout << "ShardWriter: " + to_string(info.size()) + " shards written in " + dir << endl;
+#endif
+	};
+};
+
+////////////////////////////////////////////////////////////////////
+// Read side: keeps the index in memory, mmaps shards on demand.
+// Lookups may run concurrently; only the shard mapping is locked.
+class ShardedTable: public ApproxLookup {
+public:
+	std::string dir;
+	int divisions;
+	double epsilon;          // first search radius of lookup()
+	std::vector<tShardInfo> shards;
+	std::map<int, tShardMap> mapped;
+	std::mutex map_lock;
+
+	ShardedTable(std::string d, double eps) {
+		dir = d;
+		epsilon = eps;
+		divisions = 0;
+		open();
+	};
+
+	~ShardedTable() {
+		close();
+	};
+
+	void open() {
+		tIndexHeader ih;
+		ifstream idx(dir + "/index.skt", ios::binary);
+
+		if (!idx.read((char *)&ih, sizeof(ih)) || memcmp(ih.magic, index_magic, 8) != 0)
+			throw runtime_error("No shard index in " + dir);
+		divisions = ih.divisions;
+		shards.resize(ih.n_shards);
+		if (ih.n_shards > 0) idx.read((char *)shards.data(), ih.n_shards * sizeof(tShardInfo));
+		if (!idx) throw runtime_error("Truncated shard index in " + dir);
+	};
+
+	void close() {
+		for (auto &m : mapped) munmap(m.second.base, m.second.bytes);
+		mapped.clear();
+	};
+
+	const tShardHeader *map_shard(int cell) {
+		std::lock_guard<std::mutex> guard(map_lock);
+		if (mapped.count(cell) == 0) {
+			struct stat st;
+			std::string path = dir + "/shard_" + to_string(cell) + ".skt";
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) throw runtime_error("Cannot open " + path);
+			if (fstat(fd, &st) != 0) {
+				::close(fd);
+				throw runtime_error("Cannot stat " + path);
+			};
+			if ((size_t)st.st_size < sizeof(tShardHeader)) {
+				::close(fd);
+				throw runtime_error("Truncated shard " + path);
+			};
+			void *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+			::close(fd);
+			if (base == MAP_FAILED) throw runtime_error("Cannot mmap " + path);
+			// The magic carries the format version; the size must be the
+			// header, a whole number of records and the ancestors blob
+			const tShardHeader *sh = (const tShardHeader *)base;
+			uint64_t body = (uint64_t)st.st_size - sizeof(tShardHeader);
+			if ((memcmp(sh->magic, shard_magic, 8) != 0) || (sh->seq_bytes > body)
+				|| ((body - sh->seq_bytes) % sizeof(tShardRecord) != 0)
+				|| ((body - sh->seq_bytes) / sizeof(tShardRecord) != sh->count)) {
+				munmap(base, st.st_size);
+				throw runtime_error("Bad shard file " + path);
+			};
+			tShardMap sm;
+			sm.base = base;
+			sm.bytes = st.st_size;
+			mapped[cell] = sm;
+		};
+		return((const tShardHeader *)mapped[cell].base);
+	};
+
+	// Closest entry among the shards within eps of the target.
+	// first is HUGE_VAL when no shard is close enough.
+	tApproxHit nearest(cx_mat target, double eps) {
+		tQuat q = utils::su2_quaternion(target);
+		double best_dist = HUGE_VAL;
+		const tShardRecord *best = NULL;
+		const char *best_blob = NULL;
+
+		for (auto &info : shards) {
+			if (!shard_within(info, q, eps)) continue;
+			const tShardHeader *sh = map_shard(info.cell);
+			const tShardRecord *recs = (const tShardRecord *)(sh + 1);
+			for (uint64_t i = 0; i < sh->count; i++) {
+				tQuat p = { recs[i].q[0], recs[i].q[1], recs[i].q[2], recs[i].q[3] };
+				double dist = utils::quaternion_distance(q, p);
+				if (dist < best_dist) {
+					best_dist = dist;
+					best = &recs[i];
+					best_blob = (const char *)(recs + sh->count);
+				};
+			};
+		};
+
+		if (best == NULL) return(make_pair(HUGE_VAL, Oper()));
+		tQuat p = { best->q[0], best->q[1], best->q[2], best->q[3] };
+		std::string ancs(best_blob + best->seq_off, best->seq_len);
+		return(make_pair(best_dist, Oper(ancs, utils::quaternion_matrix(p), ancs)));
+	};
+
+	// Widens the radius until something is found. A hit farther than the
+	// radius searched may still be beaten by a shard just outside it, so
+	// the search is repeated once with the hit distance as radius.
+	tApproxHit lookup(cx_mat target) {
+		tApproxHit hit;
+		double eps = epsilon;
+		SKT_PERF_REGION("ShardedTable::lookup");
+
+		do {
+			hit = nearest(target, eps);
+			eps *= 2;
+		} while ((hit.first == HUGE_VAL) && (eps < 2));
+		if (hit.first == HUGE_VAL) hit = nearest(target, 2);
+		else if (hit.first > eps / 2) hit = nearest(target, hit.first);
+		return(hit);
+	};
+};
+
+////////////////////////////////////////////////////////////////////
+// Frontier files hold one generation (matrix + ancestors) so the next one
+// can be built by streaming it back instead of keeping it in memory.
+
+void write_frontier_op(ofstream &out, tOper &op) {
+	double m[8];
+	uint32_t len = (uint32_t)op.ancestors.length();
+
+	for (int i = 0; i < 4; i++) {
+		m[2 * i] = real(op.matrix(i % 2, i / 2));
+		m[2 * i + 1] = imag(op.matrix(i % 2, i / 2));
+	};
+	out.write((const char *)m, sizeof(m));
+	out.write((const char *)&len, sizeof(len));
+	out.write(op.ancestors.data(), len);
+};
+
+bool read_frontier_op(ifstream &in, tOper &op) {
+	double m[8];
+	uint32_t len;
+	cx_mat matrix(2, 2);
+
+	if (!in.read((char *)m, sizeof(m))) return(false);
+	if (!in.read((char *)&len, sizeof(len))) return(false);
+	std::string ancs(len, ' ');
+	if (!in.read(&ancs[0], len)) return(false);
+	for (int i = 0; i < 4; i++) matrix(i % 2, i / 2) = complex<double>(m[2 * i], m[2 * i + 1]);
+	op = Oper(ancs, matrix, ancs);
+	return(true);
+};
+
+// Generate table of basic approximations straight into shards.
+// Generation l is read back one prefix at a time from its frontier file
+// to produce generation l+1, so no whole level is ever held in RAM.
+void basic_approxes_sharded(int ll0, BasicApproxSettings &sett, ShardWriter &writer) {
+	std::string frontier = writer.dir + "/level_1.frt";
+	size_t level_count = 0;
+	SKT_PERF_REGION("basic_approxes_sharded");
+	{
+		ofstream out(frontier, ios::binary | ios::trunc);
+		for (auto insn : sett.iset) {
+			writer.add(insn);
+			write_frontier_op(out, insn);
+		};
+	}
+
+	for (int l = 2; l <= ll0; l++) {
+		std::string next = writer.dir + "/level_" + to_string(l) + ".frt";
+		ifstream in(frontier, ios::binary);
+		ofstream out(next, ios::binary | ios::trunc);
+		tOper prefix;
+
+		level_count = 0;
+		while (read_frontier_op(in, prefix)) {
+			tArrayOp children = {};
+			sett.gen_basic_approx_children(sett, prefix, children);
+			for (auto &child : children) {
+				writer.add(child);
+				if (l < ll0) write_frontier_op(out, child);
+			};
+			level_count += children.size();
+		};
+		in.close();
+		out.close();
+		remove(frontier.c_str());
+		frontier = next;
+		cout << "Generation " + to_string(l) + ": " + to_string(level_count) + " sequences" << endl;
+	};
+	remove(frontier.c_str());
+	writer.finalize();
+};
+
+#endif // shard_h__
@@ -10,7 +10,6 @@
 #include "config.hpp"
 
 using namespace std;
-typedef std::vector<tOper> tArrayOp;
 typedef std::pair<bool, tArrayOp> tRuleOut;
 typedef std::pair<size_t, tArrayOp> tSimplified;
 
@@ -19,13 +18,13 @@ public:
 	std::string slogan, id_sym;
 	size_t arg_count;
 
-	SimplifyRule::SimplifyRule(std::string slo, int arg_c, std::string ii) {
+	SimplifyRule(std::string slo, int arg_c, std::string ii) {
 		slogan = slo;
 		arg_count = arg_c;
 		id_sym = ii;
 	};
 
-	SimplifyRule::SimplifyRule(tArrayOp aOp, std::string new_sym) {
+	SimplifyRule(tArrayOp aOp, std::string new_sym) {
 		slogan = "";
 		id_sym = new_sym;
 		arg_count = aOp.end() - aOp.begin();
@@ -33,7 +32,7 @@ public:
 		slogan += " = " + id_sym;
 	};
 
-	SimplifyRule::SimplifyRule(tArrayOp aOp) {
+	SimplifyRule(tArrayOp aOp) {
 		slogan = "";
 		id_sym = "I";
 		arg_count = aOp.end() - aOp.begin();
@@ -46,6 +45,9 @@ public:
 	// tRuleOut simplify() { <subclass method> _simplify__(); }
 	// FACTORY!
 
+	virtual ~SimplifyRule() {
+	};
+
 	virtual tRuleOut simplify(tArrayOp pp) {
 		return(make_pair(false, pp ));
 	};
@@ -62,11 +64,11 @@ class IdentityRule: public SimplifyRule {
 public:
 	std::string id_sym;
 
-	IdentityRule::IdentityRule(int d) : SimplifyRule("I*Q = Q", 2,"I") {
+	IdentityRule(int) : SimplifyRule("I*Q = Q", 2,"I") {
 		id_sym = "I";
 	};
 
-	tRuleOut IdentityRule::simplify(tArrayOp);
+	tRuleOut simplify(tArrayOp);
 };
 
 tRuleOut IdentityRule::simplify(tArrayOp OpArr) {
@@ -86,7 +88,7 @@ tRuleOut IdentityRule::simplify(tArrayOp OpArr) {
 
 	// This code is the same for each simplification rule
 	if (activated) {
-		for (int i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
+		for (size_t i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
 		OpArr.insert(OpArr.begin(), C);
 	}
 	return(make_pair(activated,OpArr));
@@ -97,12 +99,12 @@ public:
 	std::string id_sym;
 	tOper symbol;
 
-	DoubleIdentityRule::DoubleIdentityRule(tOper symb) : SimplifyRule("Q*Q = I", 2, "I") {
+	DoubleIdentityRule(tOper symb) : SimplifyRule("Q*Q = I", 2, "I") {
 		symbol = symb;
 		id_sym = "I";
 	};
 
-	tRuleOut DoubleIdentityRule::simplify(tArrayOp);
+	tRuleOut simplify(tArrayOp);
 };
 
 tRuleOut DoubleIdentityRule::simplify(tArrayOp OpArr) {
@@ -120,7 +122,7 @@ tRuleOut DoubleIdentityRule::simplify(tArrayOp OpArr) {
 
 	// This code is the same for each simplification rule
 	if (activated) {
-		for (int i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
+		for (size_t i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
 		OpArr.insert(OpArr.begin(), C);
 	}
 	return(make_pair(activated, OpArr));
@@ -130,11 +132,11 @@ class AdjointRule: public SimplifyRule {
 public:
 	std::string id_sym;
 
-	AdjointRule::AdjointRule(int d) : SimplifyRule("Q*Q\\dagger = I", 2, "I") {
+	AdjointRule(int) : SimplifyRule("Q*Q\\dagger = I", 2, "I") {
 		id_sym = "I";
 	};
 
-	tRuleOut AdjointRule::simplify(tArrayOp);
+	tRuleOut simplify(tArrayOp);
 };
 
 tRuleOut AdjointRule::simplify(tArrayOp OpArr) {
@@ -143,18 +145,18 @@ tRuleOut AdjointRule::simplify(tArrayOp OpArr) {
 	A = OpArr[0];
 	B = OpArr[1];
 	// C = "";
-	if ((A.name	== B.name.substr(B.name.size()-1)) && (B.name.back() == 'd')) {
+	if ((A.name	== B.name.substr(0, B.name.size()-1)) && (B.name.back() == 'd')) {
 		activated = true;
 		C = Oper(id_sym, eye<cx_mat>(A.matrix.n_rows, A.matrix.n_rows));
 	}
-	else if ((B.name == A.name.substr(A.name.size() - 1)) && (A.name.back() == 'd')) {
+	else if ((B.name == A.name.substr(0, A.name.size() - 1)) && (A.name.back() == 'd')) {
 		activated = true;
 		C = Oper(id_sym, eye<cx_mat>(A.matrix.n_rows, A.matrix.n_rows));
 	}
 
 	// This code is the same for each simplification rule
 	if (activated) {
-		for (int i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
+		for (size_t i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
 		OpArr.insert(OpArr.begin(), C);
 	}
 	return(make_pair(activated, OpArr));
@@ -165,17 +167,17 @@ public:
 	std::string id_sym;
 	tArrayOp sequence;
 
-	GeneralRule::GeneralRule(tArrayOp seqs, std::string new_sym) : SimplifyRule(seqs, new_sym) {
+	GeneralRule(tArrayOp seqs, std::string new_sym) : SimplifyRule(seqs, new_sym) {
 		id_sym = new_sym;
 		sequence = seqs;
 	};
 
-	GeneralRule::GeneralRule(tArrayOp seqs) : SimplifyRule(seqs) {
+	GeneralRule(tArrayOp seqs) : SimplifyRule(seqs) {
 		id_sym = "I";
 		sequence = seqs;
 	};
 
-	tRuleOut GeneralRule::simplify(tArrayOp);
+	tRuleOut simplify(tArrayOp);
 };
 
 tRuleOut GeneralRule::simplify(tArrayOp OpArr) {
@@ -185,8 +187,8 @@ tRuleOut GeneralRule::simplify(tArrayOp OpArr) {
 
 	nullOpArr.clear();
 
-	for (int i = 0; i < arg_count; i++) {
-		if (sequence[i].name != OpArr[i].name) return(make_pair(false,nullOpArr));
+	for (size_t i = 0; i < arg_count; i++) {
+		if (sequence[i].name != OpArr[i].name) return(make_pair(false,OpArr));
 	};
 
 	activated = true;
@@ -203,7 +205,7 @@ tRuleOut GeneralRule::simplify(tArrayOp OpArr) {
 #ifdef _DEBUG
 		cout << slogan + "(" + to_string(arg_count) + ")" + " OBTAINS!" << endl;
 #endif
-		for (int i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
+		for (size_t i = 0; i < arg_count; i++) OpArr.erase(OpArr.begin());
 		OpArr.insert(OpArr.begin(), C);
 #ifdef _DEBUG
 		for (auto i : OpArr) cout << i.name;
@@ -213,12 +215,41 @@ tRuleOut GeneralRule::simplify(tArrayOp OpArr) {
 	return(make_pair(activated, OpArr));
 };
 
+// Rewrites a sequence into an equivalent shorter one (found by the
+// rule miner, see rulemine.hpp). An empty replacement is the identity.
+class RewriteRule: public SimplifyRule {
+public:
+	tArrayOp sequence;
+	tArrayOp replacement;
+
+	RewriteRule(tArrayOp seqs, tArrayOp repl) : SimplifyRule(seqs, repl.empty() ? std::string("I") : utils::list_as_string(repl)) {
+		sequence = seqs;
+		replacement = repl;
+	};
+
+	tRuleOut simplify(tArrayOp);
+};
+
+tRuleOut RewriteRule::simplify(tArrayOp OpArr) {
+	for (size_t i = 0; i < arg_count; i++) {
+		if (sequence[i].name != OpArr[i].name) return(make_pair(false, OpArr));
+	};
+
+#ifdef _DEBUG
+	cout << slogan + " OBTAINS!" << endl;
+#endif
+	OpArr.erase(OpArr.begin(), OpArr.begin() + arg_count);
+	if (replacement.empty()) OpArr.insert(OpArr.begin(), Oper(id_sym, eye<cx_mat>(sequence[0].matrix.n_rows, sequence[0].matrix.n_rows)));
+	else OpArr.insert(OpArr.begin(), replacement.begin(), replacement.end());
+	return(make_pair(true, OpArr));
+};
+
 class SimplifyEngine {
 public:
 	ruleSet rs;
 	size_t max_arg_count;
 
-	SimplifyEngine::SimplifyEngine(ruleSet rs_1) {
+	SimplifyEngine(ruleSet rs_1) {
 		rs = rs_1;
 		max_arg_count = 0;
 		for (auto rule : rs_1) {
@@ -226,7 +257,7 @@ public:
 		};
 	};
 
-	SimplifyEngine::SimplifyEngine() {
+	SimplifyEngine() {
 		max_arg_count = 0;
 	}
 
@@ -254,6 +285,7 @@ public:
 
 		while (long_enough && (scratch.size() < max_arg_count)) {
 			oo = transfer_to_scratch(sequence, scratch);
+			long_enough = oo.first;
 		};
 		return(sequence);
 	};
@@ -262,6 +294,7 @@ public:
 		size_t simplify_length = sequence.size();
 		tArrayOp scratch_sequence {};
 		tRuleOut resRule;
+		SKT_PERF_REGION("SimplifyEngine::simplify");
 
 		bool global_obtains = true;
 
@@ -283,6 +316,7 @@ public:
 					for (size_t i = split; i < scratch_sequence.size(); i++) scratch_subset.push_back(scratch_sequence[i]);
 					resRule = rule->simplify(scratch_subset);
 					scratch_subset = resRule.second;
+					scratch_sequence.resize(scratch_excess.size() + scratch_subset.size());
 					for (size_t i = 0; i < scratch_excess.size(); i++) scratch_sequence[i] = scratch_excess[i];
 					for (size_t i = 0; i < scratch_subset.size(); i++) scratch_sequence[i + scratch_excess.size()] = scratch_subset[i];
 					
@@ -326,6 +360,17 @@ public:
 			return new IdentityRule(0);
 		};
 	};
+
+	virtual SimplifyRule *Make(int type, tArrayOp OP, tArrayOp RES)
+	{
+		switch (type)
+		{
+		case 4:
+			return new RewriteRule(OP, RES);
+		default:
+			return Make(type, OP);
+		};
+	};
 };
 
 #endif // simplify_h__
\ No newline at end of file
@@ -0,0 +1,130 @@
+// Solovay-Kitaev recursion on top of a table of basic approximations,
+// with an anytime driver
+//
+// sk(U, 0) is the table hit; sk(U, n) corrects sk(U, n-1) with the balanced
+// group commutator of the residual U sk(U, n-1)^dagger. Since level n starts
+// from level n-1, approximate() deepens one level at a time and always holds
+// the best sequence found so far: it stops at a wall clock deadline, at a
+// target error or at max_depth, whichever comes first.
+
+#ifndef sk_h__
+#define sk_h__
+
+#include <chrono>
+#include <functional>
+#include "config.hpp"
+
+struct tAnytimeResult {
+	tOper approx;            // best sequence found so far
+	double error;            // fowler distance to the target
+	int depth;               // SK level of approx, 0 is the table hit
+	bool complete;           // stopped by max_depth or target error, not by the deadline
+	double seconds;
+};
+
+struct tDeadlineExpired {
+};
+
+class SKApprox {
+public:
+	ApproxLookup *base;
+	BasicApproxSettings *settings;
+	bool has_deadline;
+	std::chrono::steady_clock::time_point deadline;
+	std::function<void(tAnytimeResult &)> progress;   // called on every improvement, if set
+
+	SKApprox(ApproxLookup &b, BasicApproxSettings &sett) {
+		base = &b;
+		settings = &sett;
+		has_deadline = false;
+	};
+
+	tOper compose(tOper &a, tOper &b) {
+		tOper c = a.multiply(b, "");
+		c.name = c.ancestors;
+		return(c);
+	};
+
+	tOper dagger(tOper &a) {
+		std::string ancs = settings->dagger_sequence(a.ancestors);
+		return(Oper(ancs, a.matrix.t(), ancs));
+	};
+
+	// Balanced group commutator U = V W V^dagger W^dagger, in closed form
+	// on quaternions (utils::quaternion_gc)
+	std::pair<cx_mat, cx_mat> gc_decompose(cx_mat U) {
+		tQuat v, w;
+
+		utils::quaternion_gc(utils::su2_quaternion(U), v, w);
+		return(make_pair(utils::quaternion_matrix(v), utils::quaternion_matrix(w)));
+	};
+
+	// One SK level on top of prev = sk(U, n-1)
+	tOper sk_level(cx_mat U, int n, tOper &prev) {
+		std::pair<cx_mat, cx_mat> vw = gc_decompose(U * prev.matrix.t());
+		tOper v = solovay_kitaev(vw.first, n - 1);
+		tOper w = solovay_kitaev(vw.second, n - 1);
+		tOper vd = dagger(v);
+		tOper wd = dagger(w);
+		tOper res = compose(v, w);
+
+		res = compose(res, vd);
+		res = compose(res, wd);
+		res = compose(res, prev);
+		tArrayOp seq = settings->reduce_adjacent(settings->ancestors_to_array(res.ancestors));
+		res.ancestors = utils::list_as_string(seq);
+		res.name = res.ancestors;
+		return(res);
+	};
+
+	tOper solovay_kitaev(cx_mat U, int n) {
+		if (has_deadline && (std::chrono::steady_clock::now() > deadline)) throw tDeadlineExpired();
+		if (n == 0) return(base->lookup(U).second);
+		tOper prev = solovay_kitaev(U, n - 1);
+		return(sk_level(U, n, prev));
+	};
+
+	// seconds <= 0 means no deadline, target_error <= 0 means full depth
+	tAnytimeResult approximate(cx_mat U, int max_depth, double seconds, double target_error) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		tAnytimeResult best;
+		tOper current;
+
+		has_deadline = (seconds > 0);
+		deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+
+		current = base->lookup(U).second;
+		best.approx = current;
+		best.error = utils::fowler_distance(current.matrix, U);
+		best.depth = 0;
+		best.complete = true;
+		if (progress) progress(best);
+
+		for (int n = 1; (n <= max_depth) && (best.error > target_error); n++) {
+			try {
+				current = sk_level(U, n, current);
+			}
+			catch (tDeadlineExpired &) {
+				best.complete = false;
+				break;
+			};
+			double error = utils::fowler_distance(current.matrix, U);
+			if (error < best.error) {
+				best.approx = current;
+				best.error = error;
+				best.depth = n;
+				if (progress) progress(best);
+			};
+#ifdef _DEBUG
+			cout << "SK level " + to_string(n) + ": error " + to_string(error) + ", length " + to_string(current.ancestors.length()) << endl;
+#endif
+		};
+
+		has_deadline = false;
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		best.seconds = elapsed.count();
+		return(best);
+	};
+};
+
+#endif // sk_h__
@@ -0,0 +1,80 @@
+// Command line client of the approximation daemon (see client.hpp)
+//
+// usage: sktc <socket> approx re00 im00 re01 im01 re10 im10 re11 im11
+//        sktc <socket> simplify <ancestors>
+//        sktc <socket> stats
+//        sktc <socket> bench <n>    pipelined random targets, client side latency
+#include <string>
+#include <chrono>
+#include <armadillo>
+#include "config.hpp"
+#include "client.hpp"
+#include "server.hpp"
+
+int main(int argc, char *argv[]) {
+
+	if (argc < 3) {
+		cout << "usage: sktc <socket> approx|simplify|stats|bench [args]" << endl;
+		return(1);
+	};
+	std::string cmd = argv[2];
+
+	try {
+		ApproxClient client(argv[1]);
+
+		if ((cmd == "approx") && (argc == 11)) {
+			cx_mat target(2, 2);
+			for (int i = 0; i < 4; i++) target(i / 2, i % 2) = complex<double>(atof(argv[3 + 2 * i]), atof(argv[4 + 2 * i]));
+			tApproxHit hit = client.approximate(target);
+			cout << hit.second.ancestors << " " << hit.first << endl;
+		}
+		else if ((cmd == "simplify") && (argc == 4)) {
+			std::pair<size_t, std::string> simp = client.simplify(argv[3]);
+			cout << simp.second << " (" + to_string(simp.first) + " removed)" << endl;
+		}
+		else if (cmd == "stats") {
+			cout << client.stats();
+		}
+		else if ((cmd == "bench") && (argc == 4)) {
+			// Keeps a window of requests in flight on the connection
+			int n = atoi(argv[3]);
+			size_t window = 64;
+			std::map<uint32_t, std::chrono::steady_clock::time_point> sent;
+			std::vector<double> usecs;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < n || !sent.empty();) {
+				if ((i < n) && (sent.size() < window)) {
+					tQuat q;
+					double norm = 0;
+					for (auto &x : q) {
+						x = rand() / (double)RAND_MAX - 0.5;
+						norm += x*x;
+					};
+					for (auto &x : q) x /= sqrt(norm);
+					sent[client.send_approx(utils::quaternion_matrix(q))] = std::chrono::steady_clock::now();
+					i++;
+					continue;
+				};
+				tWireMessage msg = client.receive();
+				std::chrono::duration<double, std::micro> usec = std::chrono::steady_clock::now() - sent[msg.hdr.id];
+				usecs.push_back(usec.count());
+				sent.erase(msg.hdr.id);
+			};
+			std::chrono::duration<double> total = std::chrono::steady_clock::now() - start;
+			cout << to_string(n) + " requests in " + to_string(total.count()) + " s, usec"
+				+ " p50=" + to_string(LatencyStats::percentile(usecs, 0.50))
+				+ " p90=" + to_string(LatencyStats::percentile(usecs, 0.90))
+				+ " p99=" + to_string(LatencyStats::percentile(usecs, 0.99)) << endl;
+		}
+		else {
+			cout << "usage: sktc <socket> approx|simplify|stats|bench [args]" << endl;
+			return(1);
+		};
+	}
+	catch (exception &e) {
+		cout << e.what() << endl;
+		return(1);
+	};
+	return(0);
+};
@@ -0,0 +1,47 @@
+// Approximation daemon: loads the table and the simplification rules once
+// and serves requests over a Unix domain socket (see server.hpp)
+//
+// usage: sktd <socket> <table dir> [l0] [workers]
+// When <table dir> holds no index yet the table is generated there first.
+#include <string>
+#include <armadillo>
+#include <sys/stat.h>
+#include "config.hpp"
+#include "server.hpp"
+
+void stop_handler(int) {
+	skt_server_stop = 1;
+};
+
+int main(int argc, char *argv[]) {
+
+	if (argc < 3) {
+		cout << "usage: sktd <socket> <table dir> [l0] [workers]" << endl;
+		return(1);
+	};
+	std::string socket_path = argv[1];
+	std::string table_dir = argv[2];
+	int l0 = (argc > 3) ? atoi(argv[3]) : 16;
+	int n_workers = (argc > 4) ? atoi(argv[4]) : (int)std::max(1u, std::thread::hardware_concurrency());
+
+	initOperConstants();
+
+	BasicApproxSettings settings;
+
+	init_default_settings(settings);
+
+	struct stat st;
+	if (stat((table_dir + "/index.skt").c_str(), &st) != 0) {
+		mkdir(table_dir.c_str(), 0755);
+		ShardWriter writer(table_dir, 2);
+		basic_approxes_sharded(l0, settings, writer);
+	};
+	ShardedTable table(table_dir, 0.05);
+
+	signal(SIGINT, stop_handler);
+	signal(SIGTERM, stop_handler);
+
+	ApproxServer server(socket_path, &table, &settings, n_workers);
+	server.run();
+	return(0);
+};
@@ -0,0 +1,117 @@
+// Multi-process table generation (see distgen.hpp)
+//
+// usage: sktgen local <dir> <l0> <n>           forks n workers per level, then builds the table
+//        sktgen init <dir> <n>                 level 1
+//        sktgen worker <dir> <l> <w> <n>       worker w of level l
+//        sktgen merge <dir> <l> <b> <n>        merger b of level l, after all workers of l
+//        sktgen finalize <dir> <l0> <n>        shard files and index, after all mergers of l0
+//        sktgen --plan <eps> [MB] [ms]         prints the planned l0, SK depth and table variant for
+//                                              error eps within MB of memory (512) and ms per target
+//                                              (50), from small tables measured here, then exits
+//        sktgen --mine <rules> <l0>            mines simplification rules up to l0 into the file <rules>
+//        sktgen --rules <rules> <command>      any command above, pruning with the rules of the file too;
+//                                              every step of a distributed run must be given the same file
+// The init, worker, merge and finalize steps can run on different hosts sharing <dir>.
+#include <string>
+#include <armadillo>
+#include <sys/stat.h>
+#include "config.hpp"
+
+const std::string usage = "usage: sktgen [--rules <rules>] local|init|worker|merge|finalize <dir> [args] | --plan <eps> [MB] [ms]"
+	" | --mine <rules> <l0>";
+
+int main(int argc, char *argv[]) {
+	std::string rules_file;
+
+	if ((argc >= 3) && (std::string(argv[1]) == "--rules")) {
+		rules_file = argv[2];
+		argc -= 2;
+		argv += 2;
+	};
+	if ((argc < 4) && !((argc >= 3) && (std::string(argv[1]) == "--plan"))) {
+		cout << usage << endl;
+		return(1);
+	};
+	std::string cmd = argv[1];
+	std::string dir = argv[2];
+
+	initOperConstants();
+
+	BasicApproxSettings settings;
+
+	init_default_settings(settings);
+
+	if (!rules_file.empty()) {
+		try {
+			ruleSet rs = settings.rSet;
+			ruleSet mined = load_rules(rules_file, settings);
+			rs.insert(rs.end(), mined.begin(), mined.end());
+			settings.init_simplify_engine(rs);
+			cout << to_string(mined.size()) + " rules from " + rules_file << endl;
+		}
+		catch (exception &e) {
+			cout << e.what() << endl;
+			return(1);
+		};
+	};
+
+	if (cmd == "--mine") {
+		RuleMiner miner(settings, 200);
+		miner.mine(atoi(argv[3]), settings.rSet);
+		try {
+			miner.save(dir);
+		}
+		catch (exception &e) {
+			cout << e.what() << endl;
+			return(1);
+		};
+		cout << to_string(miner.rules.size()) + " rules written to " + dir << endl;
+		return(0);
+	};
+
+	if (cmd == "--plan") {
+		ApproxPlanner planner(settings, 10, 100);
+		double megabytes = (argc > 3) ? atof(argv[3]) : 512;
+		double ms = (argc > 4) ? atof(argv[4]) : 50;
+		tPlan p = planner.plan(atof(argv[2]), megabytes * 1048576, ms / 1e3, 24, 6);
+		planner.print_plan(p);
+		return(p.feasible ? 0 : 1);
+	};
+
+	try {
+		mkdir(dir.c_str(), 0755);
+		if ((cmd == "local") && (argc == 5)) {
+			DistributedGenerator gen(settings, dir, atoi(argv[4]));
+			ShardWriter writer(dir, 2);
+			gen.run_local(atoi(argv[3]), writer);
+		}
+		else if ((cmd == "init") && (argc == 4)) {
+			DistributedGenerator gen(settings, dir, atoi(argv[3]));
+			gen.init_level();
+		}
+		else if ((cmd == "worker") && (argc == 6)) {
+			DistributedGenerator gen(settings, dir, atoi(argv[5]));
+			gen.worker(atoi(argv[3]), atoi(argv[4]));
+		}
+		else if ((cmd == "merge") && (argc == 6)) {
+			DistributedGenerator gen(settings, dir, atoi(argv[5]));
+			size_t n = gen.merge(atoi(argv[3]), atoi(argv[4]));
+			cout << to_string(n) + " sequences" << endl;
+		}
+		else if ((cmd == "finalize") && (argc == 5)) {
+			DistributedGenerator gen(settings, dir, atoi(argv[4]));
+			ShardWriter writer(dir, 2);
+			gen.finalize(atoi(argv[3]), writer);
+			gen.cleanup(atoi(argv[3]));
+		}
+		else {
+			cout << usage << endl;
+			return(1);
+		};
+	}
+	catch (exception &e) {
+		cout << e.what() << endl;
+		return(1);
+	};
+	return(0);
+};
@@ -0,0 +1,125 @@
+// Streaming simplification with a push API
+//
+// SimplifyEngine::simplify needs the whole sequence. StreamSimplifier takes
+// the gates one at a time instead: each new gate enters a window of at most
+// depth gates (max_arg_count by default), the rules are applied at the tail
+// of the window until none obtains, and the gates pushed out of the window
+// are final and go to the sink. Memory is O(depth) and the work per gate is
+// bounded by the rules times the window. A StreamSimplifier is itself a
+// GateSink, so stages chain (approximation -> simplifier -> ...).
+
+#ifndef stream_h__
+#define stream_h__
+
+#include <deque>
+#include <string>
+#include "config.hpp"
+
+class GateSink {
+public:
+	virtual void push(tOper &op) = 0;
+	virtual void flush() {
+	};
+};
+
+// End of a pipeline collecting the gates
+class ArraySink: public GateSink {
+public:
+	tArrayOp gates;
+
+	void push(tOper &op) {
+		gates.push_back(op);
+	};
+};
+
+class StreamSimplifier: public GateSink {
+public:
+	SimplifyEngine *engine;
+	GateSink *sink;
+	size_t depth;
+	std::deque<tOper> window;
+	std::string id_sym;
+	size_t n_in, n_out, n_rewrites;
+
+	StreamSimplifier(SimplifyEngine &e, GateSink &s, size_t d) {
+		engine = &e;
+		sink = &s;
+		depth = std::max((size_t)1, d);
+		id_sym = "I";
+		n_in = 0;
+		n_out = 0;
+		n_rewrites = 0;
+	};
+
+	StreamSimplifier(SimplifyEngine &e, GateSink &s) : StreamSimplifier(e, s, e.max_arg_count) {
+	};
+
+	// Rules at the tail of the window until none obtains. The identities
+	// left by the rules are dropped.
+	void reduce() {
+		bool obtains = true;
+
+		while (obtains) {
+			obtains = false;
+			for (auto rule : engine->rs) {
+				if ((rule->arg_count == 0) || (window.size() < rule->arg_count)) continue;
+				tArrayOp tail(window.end() - rule->arg_count, window.end());
+				tRuleOut res = rule->simplify(tail);
+				if (!res.first) continue;
+				window.erase(window.end() - rule->arg_count, window.end());
+				for (auto &op : res.second) {
+					if (op.name != id_sym) window.push_back(op);
+				};
+				n_rewrites++;
+				obtains = true;
+			};
+		};
+	};
+
+	void push(tOper &op) {
+		n_in++;
+		if (op.name == id_sym) return;
+		window.push_back(op);
+		reduce();
+		while (window.size() > depth) {
+			sink->push(window.front());
+			window.pop_front();
+			n_out++;
+		};
+	};
+
+	// End of stream: the window is final too
+	void flush() {
+		while (!window.empty()) {
+			sink->push(window.front());
+			window.pop_front();
+			n_out++;
+		};
+		sink->flush();
+	};
+};
+
+// Pushes the gates of a sequence (e.g. an approximation) down a pipeline
+void push_sequence(BasicApproxSettings &sett, tOper &seq, GateSink &sink) {
+	tArrayOp gates = sett.ancestors_to_array(seq.ancestors);
+	for (auto &g : gates) sink.push(g);
+};
+
+// Whole sequence in a window holding all of it, so no gate is final before
+// the end; passes are repeated until one rewrites nothing, which leaves no
+// rule applicable anywhere in the result
+tArrayOp simplify_sequence(SimplifyEngine &e, tArrayOp seq) {
+	size_t rewrites = 1;
+
+	while (rewrites > 0) {
+		ArraySink out;
+		StreamSimplifier ss(e, out, std::max((size_t)1, seq.size()));
+		for (auto &g : seq) ss.push(g);
+		ss.flush();
+		rewrites = ss.n_rewrites;
+		seq = out.gates;
+	};
+	return(seq);
+};
+
+#endif // stream_h__
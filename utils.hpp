@@ -7,11 +7,19 @@
 #include <assert.h>
 #include <algorithm>
 #include <numeric>
+#include <array>
+#include "perfcount.hpp"
 
 
 using namespace arma;
 using namespace std;
 
+typedef std::array<double, 4> tQuat;  // unit quaternion (w,x,y,z) of an SU(2) operator
+typedef std::array<double, 3> tAxisAngle;  // rotation vector theta n
+typedef std::array<long long, 4> tQuatKey;  // quaternion on a grid: map key of an operator
+
+const double quaternion_key_resolution = 1e-7;
+
 namespace utils {
 
 	cx_mat matrixify(complex<double> d) {
@@ -95,6 +103,7 @@ namespace utils {
 		double frac;
 	
 		cx_mat prod(sz,sz);
+		SKT_PERF_COUNT("utils::fowler_distance");
 		assert(A.n_cols==B.n_cols);
 		prod = A.t() * B;
 		tr = trace(prod);
@@ -102,6 +111,179 @@ namespace utils {
 		return(sqrt(abs(frac)));
 	};
 
+	// Quaternion of a 2x2 unitary with its global phase removed:
+	// A = e^{i phi} (w I - i x SX - i y SY - i z SZ).
+	// q and -q are the same operator, so the first non-zero component is
+	// made positive (this puts every operator in the w >= 0 hemisphere).
+	tQuat su2_quaternion(cx_mat A)
+	{
+		tQuat q;
+		complex<double> phase, v00, v01, v10, v11;
+
+		assert((A.n_rows == 2) && (A.n_cols == 2));
+		phase = sqrt(A(0, 0)*A(1, 1) - A(0, 1)*A(1, 0));
+		v00 = A(0, 0) / phase;
+		v01 = A(0, 1) / phase;
+		v10 = A(1, 0) / phase;
+		v11 = A(1, 1) / phase;
+		q[0] = real(v00 + v11) / 2;
+		q[1] = -imag(v01 + v10) / 2;
+		q[2] = real(v10 - v01) / 2;
+		q[3] = imag(v11 - v00) / 2;
+
+		for (int i = 0; i < 4; i++) {
+			if (q[i] > 0) break;
+			if (q[i] < 0) {
+				for (int j = 0; j < 4; j++) q[j] = -q[j];
+				break;
+			};
+		};
+		return(q);
+	};
+
+	// Canonical quaternion rounded to multiples of resolution, so the
+	// sequences of one unitary (up to global phase) share a map key
+	tQuatKey quaternion_key(tQuat q, double resolution = quaternion_key_resolution)
+	{
+		tQuatKey key;
+
+		for (int i = 0; i < 4; i++) key[i] = llround(q[i] / resolution);
+		return(key);
+	};
+
+	tQuatKey quaternion_key(cx_mat A, double resolution = quaternion_key_resolution)
+	{
+		return(quaternion_key(su2_quaternion(A), resolution));
+	};
+
+	// SU(2) matrix of a unit quaternion (inverse of su2_quaternion)
+	cx_mat quaternion_matrix(tQuat q)
+	{
+		cx_mat A(2, 2);
+
+		A(0, 0) = complex<double>(q[0], -q[3]);
+		A(0, 1) = complex<double>(-q[2], -q[1]);
+		A(1, 0) = complex<double>(q[2], -q[1]);
+		A(1, 1) = complex<double>(q[0], q[3]);
+		return(A);
+	};
+
+	// Hamilton product, q*p is the quaternion of the matrix product A*B
+	tQuat quaternion_multiply(tQuat q, tQuat p)
+	{
+		tQuat r;
+
+		r[0] = q[0] * p[0] - q[1] * p[1] - q[2] * p[2] - q[3] * p[3];
+		r[1] = q[0] * p[1] + q[1] * p[0] + q[2] * p[3] - q[3] * p[2];
+		r[2] = q[0] * p[2] + q[2] * p[0] + q[3] * p[1] - q[1] * p[3];
+		r[3] = q[0] * p[3] + q[3] * p[0] + q[1] * p[2] - q[2] * p[1];
+		return(r);
+	};
+
+	// Quaternion of A^dagger
+	tQuat quaternion_conjugate(tQuat q)
+	{
+		tQuat r = { q[0], -q[1], -q[2], -q[3] };
+		return(r);
+	};
+
+	// Same value as fowler_distance on the SU(2) matrices, since
+	// |tr(A^dagger B)| = 2 |q.p|
+	double quaternion_distance(tQuat q, tQuat p)
+	{
+		double dot = q[0] * p[0] + q[1] * p[1] + q[2] * p[2] + q[3] * p[3];
+		SKT_PERF_COUNT("utils::quaternion_distance");
+		return(sqrt(std::max(0.0, 1.0 - abs(dot))));
+	};
+
+	////////////////////////////////////////////////////////////////////
+	// Closed form SU(2) kernels on axis-angle vectors r = theta n, the
+	// rotation exp(-i theta/2 n.sigma) being the quaternion
+	// (cos(theta/2), sin(theta/2) n). No allocation.
+
+	tAxisAngle quaternion_log(tQuat q)
+	{
+		tAxisAngle r = { 0, 0, 0 };
+		double s, theta;
+
+		if (q[0] < 0) for (auto &x : q) x = -x;     // same operator, theta in [0, pi]
+		s = sqrt(q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		if (s < 1e-15) return(r);
+		theta = 2 * atan2(s, q[0]);
+		for (int i = 0; i < 3; i++) r[i] = theta * q[i + 1] / s;
+		return(r);
+	};
+
+	tQuat quaternion_exp(tAxisAngle r)
+	{
+		double theta = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+		tQuat q = { 1, 0, 0, 0 };
+
+		if (theta < 1e-15) return(q);
+		q[0] = cos(theta / 2);
+		for (int i = 0; i < 3; i++) q[i + 1] = sin(theta / 2) * r[i] / theta;
+		return(q);
+	};
+
+	// Rotation taking the unit vector a onto the unit vector b
+	tQuat quaternion_align(tAxisAngle a, tAxisAngle b)
+	{
+		double c = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		tQuat q = { 1 + c, a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+		double n;
+
+		if (c < -1 + 1e-12) {
+			// opposite: half turn about any axis orthogonal to a
+			tAxisAngle o = (fabs(a[0]) < 0.9) ? tAxisAngle{ 0, a[2], -a[1] } : tAxisAngle{ -a[2], 0, a[0] };
+			n = sqrt(o[0] * o[0] + o[1] * o[1] + o[2] * o[2]);
+			tQuat h = { 0, o[0] / n, o[1] / n, o[2] / n };
+			return(h);
+		};
+		n = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		for (auto &x : q) x /= n;
+		return(q);
+	};
+
+	// Balanced group commutator u = v w v^dagger w^dagger (Dawson-Nielsen):
+	// v, w rotations by phi about the X and Y axes, with
+	// sin(theta/2) = 2 sin^2(phi/2) sqrt(1 - sin^4(phi/2)), then both
+	// conjugated by the rotation taking the axis of that commutator onto
+	// the axis of u.
+	void quaternion_gc(const tQuat &u, tQuat &v, tQuat &w)
+	{
+		tAxisAngle r = quaternion_log(u);
+		double theta = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+		double phi, c, s;
+		tQuat vx, wy, comm, align;
+		tAxisAngle axis_u, axis_c;
+
+		if (theta < 1e-12) {
+			v = { 1, 0, 0, 0 };
+			w = v;
+			return;
+		};
+		phi = 2 * asin(pow((1 - cos(theta / 2)) / 2, 0.25));
+		c = cos(phi / 2);
+		s = sin(phi / 2);
+		vx = { c, s, 0, 0 };
+		wy = { c, 0, s, 0 };
+		comm = quaternion_multiply(quaternion_multiply(vx, wy), quaternion_multiply(quaternion_conjugate(vx), quaternion_conjugate(wy)));
+		axis_c = quaternion_log(comm);
+		double theta_c = sqrt(axis_c[0] * axis_c[0] + axis_c[1] * axis_c[1] + axis_c[2] * axis_c[2]);
+		for (int i = 0; i < 3; i++) {
+			axis_u[i] = r[i] / theta;
+			axis_c[i] /= theta_c;
+		};
+		align = quaternion_align(axis_c, axis_u);
+		v = quaternion_multiply(quaternion_multiply(align, vx), quaternion_conjugate(align));
+		w = quaternion_multiply(quaternion_multiply(align, wy), quaternion_conjugate(align));
+	};
+
+	void quaternion_gc_batch(const tQuat *u, tQuat *v, tQuat *w, size_t n)
+	{
+		for (size_t i = 0; i < n; i++) quaternion_gc(u[i], v[i], w[i]);
+	};
+
 	cx_mat matrix_direct_sum(cx_mat A, cx_mat B)
 	{
 		int sz = A.n_cols+B.n_cols;
@@ -122,12 +304,5 @@ namespace utils {
 		return(new_name);
 	};
 
-	string list_as_string(tArrayOp t1) {
-		string ll;
-		if (t1.size() == 0) return("");
-		for (auto ii : t1) ll += ii.name;
-		return(ll);
-	};
-
 }; // end of namespace utils
 #endif // utils_h__
\ No newline at end of file
@@ -0,0 +1,130 @@
+// Fast path for Z rotations Rz(theta) = diag(e^{-i theta/2}, e^{i theta/2})
+//
+// Only the sequences whose unitary is close to diagonal (off diagonal part
+// |(x,y)| of the quaternion at most max_offdiag) are kept, sorted by their
+// angle alpha = 2 atan2(z, w). For a diagonal target |q.p| = r cos((theta -
+// alpha)/2) with r = |(w,z)| <= 1, so an entry at angle gap d is at least
+// sqrt(1 - cos(d/2)) away: the lookup is a binary search on theta and a scan
+// outwards that stops at that bound. Any sequence with a larger off diagonal
+// part rho is at least sqrt(1 - sqrt(1 - rho^2)) away; if the best Z entry is
+// farther than that, the general table (if any) is asked as well. Targets
+// that are not diagonal go to the general table.
+
+#ifndef zrot_h__
+#define zrot_h__
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "config.hpp"
+
+struct tZEntry {
+	double angle;            // in (-pi, pi]
+	double q[4];             // canonical quaternion
+	uint32_t seq_off;        // ancestors string, offset in the blob
+	uint32_t seq_len;
+};
+
+class ZRotationTable: public ApproxLookup {
+public:
+	ApproxLookup *general;   // non diagonal targets, may be NULL
+	double max_offdiag;
+	double diagonal_tolerance;   // targets with |(x,y)| below this take the fast path
+	std::vector<tZEntry> entries;
+	std::string blob;
+
+	ZRotationTable(ApproxLookup *g, double max_od) {
+		general = g;
+		max_offdiag = max_od;
+		diagonal_tolerance = 1e-9;
+	};
+
+	static double offdiag(tQuat q) {
+		return(sqrt(q[1] * q[1] + q[2] * q[2]));
+	};
+
+	static double z_angle(tQuat q) {
+		double a = 2 * atan2(q[3], q[0]);      // (-2 pi, 2 pi], q and -q are one operator
+		if (a > datum::pi) a -= 2 * datum::pi;
+		if (a <= -datum::pi) a += 2 * datum::pi;
+		return(a);
+	};
+
+	void build(tArrayOp &table) {
+		entries.clear();
+		blob.clear();
+		for (auto &op : table) {
+			tQuat q = utils::su2_quaternion(op.matrix);
+			if (offdiag(q) > max_offdiag) continue;
+			tZEntry e;
+			e.angle = z_angle(q);
+			for (int k = 0; k < 4; k++) e.q[k] = q[k];
+			e.seq_off = (uint32_t)blob.size();
+			e.seq_len = (uint32_t)op.ancestors.length();
+			blob += op.ancestors;
+			entries.push_back(e);
+		};
+		std::sort(entries.begin(), entries.end(), [](const tZEntry &a, const tZEntry &b) { return(a.angle < b.angle); });
+#ifdef _DEBUG
+		cout << "ZRotationTable: " + to_string(entries.size()) + " of " + to_string(table.size()) + " sequences" << endl;
+#endif
+	};
+
+	tApproxHit entry_hit(size_t i, double dist) {
+		tQuat p = { entries[i].q[0], entries[i].q[1], entries[i].q[2], entries[i].q[3] };
+		std::string ancs = blob.substr(entries[i].seq_off, entries[i].seq_len);
+		return(make_pair(dist, Oper(ancs, utils::quaternion_matrix(p), ancs)));
+	};
+
+	// Nearest Z entry to Rz(theta), circular scan both ways from theta
+	tApproxHit lookup_angle(double theta) {
+		size_t n = entries.size();
+		double c = cos(theta / 2), s = sin(theta / 2);
+		double best_dist = HUGE_VAL;
+		size_t best = 0;
+
+		if (n == 0) return(make_pair(HUGE_VAL, Oper()));
+		size_t pos = std::lower_bound(entries.begin(), entries.end(), theta,
+			[](const tZEntry &e, double t) { return(e.angle < t); }) - entries.begin();
+		bool up = true, down = true;
+		for (size_t k = 0; (k < n) && (up || down); k++) {
+			size_t idx[2] = { (pos + k) % n, (pos + n - 1 - k) % n };
+			bool *dir[2] = { &up, &down };
+			for (int j = 0; j < 2; j++) {
+				if (!*dir[j]) continue;
+				tZEntry &e = entries[idx[j]];
+				double gap = fabs(theta - e.angle);
+				gap = std::min(gap, 2 * datum::pi - gap);
+				if (sqrt(std::max(0.0, 1 - cos(gap / 2))) >= best_dist) {
+					*dir[j] = false;
+					continue;
+				};
+				double dist = sqrt(std::max(0.0, 1 - fabs(c * e.q[0] + s * e.q[3])));
+				if (dist < best_dist) {
+					best_dist = dist;
+					best = idx[j];
+				};
+			};
+		};
+		return(entry_hit(best, best_dist));
+	};
+
+	tApproxHit lookup(cx_mat target) {
+		tQuat q = utils::su2_quaternion(target);
+		SKT_PERF_REGION("ZRotationTable::lookup");
+
+		if (offdiag(q) > diagonal_tolerance) {
+			if (general == NULL) throw domain_error("ZRotationTable: target is not a Z rotation");
+			return(general->lookup(target));
+		};
+		tApproxHit hit = lookup_angle(z_angle(q));
+		double outside = sqrt(1 - sqrt(1 - max_offdiag * max_offdiag));
+		if ((general != NULL) && (hit.first > outside)) {
+			tApproxHit other = general->lookup(target);
+			if (other.first < hit.first) hit = other;
+		};
+		return(hit);
+	};
+};
+
+#endif // zrot_h__